@@ -35,6 +35,10 @@ GRALLOC_HWC_FB_DISABLE_AFBC?=0
 # When enabled, buffers will never be allocated with AFBC
 GRALLOC_ARM_NO_EXTERNAL_AFBC?=0
 
+# When enabled, IP capabilities are compiled in from src/capabilities/capabilities_generated.h
+# (see src/capabilities/gen_capabilities_header.py) instead of read from /vendor/etc/gralloc/*.xml
+GRALLOC_GENERATED_CAPABILITIES?=0
+
 # For hikey960 use contiguous memory for framebuffer allocations.
 ifeq ($(TARGET_PRODUCT), hikey960)
 GRALLOC_USE_CONTIGUOUS_DISPLAY_MEMORY=1
@@ -48,6 +52,7 @@ SOONG_CONFIG_arm_gralloc := \
 	gralloc_hwc_force_bgra_8888 \
 	gralloc_hwc_fb_disable_afbc \
 	gralloc_arm_no_external_afbc \
+	gralloc_generated_capabilities \
 	gralloc_target_product
 
 SOONG_CONFIG_arm_gralloc_gralloc_use_ion_dma_heap := $(GRALLOC_USE_ION_DMA_HEAP)
@@ -55,6 +60,7 @@ SOONG_CONFIG_arm_gralloc_gralloc_use_contiguous_display_memory := $(GRALLOC_USE_
 SOONG_CONFIG_arm_gralloc_gralloc_hwc_force_bgra_8888 := $(GRALLOC_HWC_FORCE_BGRA_8888)
 SOONG_CONFIG_arm_gralloc_gralloc_hwc_fb_disable_afbc := $(GRALLOC_HWC_FB_DISABLE_AFBC)
 SOONG_CONFIG_arm_gralloc_gralloc_arm_no_external_afbc := $(GRALLOC_ARM_NO_EXTERNAL_AFBC)
+SOONG_CONFIG_arm_gralloc_gralloc_generated_capabilities := $(GRALLOC_GENERATED_CAPABILITIES)
 SOONG_CONFIG_arm_gralloc_gralloc_target_product := $(TARGET_PRODUCT)
 
 # Retrieve the directory of Gralloc module
@@ -15,9 +15,11 @@
  */
 
 #include <cutils/properties.h>
+#include <stdio.h>
 #include "allocator.h"
 #include "hidl_common/descriptor.h"
 #include "hidl_common/allocator.h"
+#include "hidl_common/heap_policy.h"
 #include "allocator/allocator.h"
 #include "usages.h"
 
@@ -60,6 +62,21 @@ Return<void> GrallocAllocator::allocate(const BufferDescriptor &descriptor, uint
 	return Void();
 }
 
+Return<void> GrallocAllocator::debug(const hidl_handle &fd, const hidl_vec<hidl_string> & /* options */)
+{
+	if (fd.getNativeHandle() == nullptr || fd->numFds < 1)
+	{
+		return Void();
+	}
+
+	const std::string dump = common::heap_policy_dump();
+	if (dprintf(fd->data[0], "%s", dump.c_str()) < 0)
+	{
+		MALI_GRALLOC_LOGW("Failed to write the heap policy dump: %s", strerror(errno));
+	}
+	return Void();
+}
+
 } // namespace allocator
 } // namespace arm
 
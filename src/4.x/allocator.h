@@ -26,6 +26,8 @@ namespace allocator
 using android::hardware::graphics::mapper::V4_0::BufferDescriptor;
 using android::hardware::Return;
 using android::hardware::hidl_handle;
+using android::hardware::hidl_string;
+using android::hardware::hidl_vec;
 
 class GrallocAllocator : public IAllocator
 {
@@ -45,6 +47,9 @@ public:
 
 	/* Override IAllocator 4.0 interface */
 	Return<void> allocate(const BufferDescriptor &descriptor, uint32_t count, allocate_cb hidl_cb) override;
+
+	/* Override IBase debug interface, used by lshal debug to dump the adaptive heap policy */
+	Return<void> debug(const hidl_handle &fd, const hidl_vec<hidl_string> &options) override;
 };
 
 } // namespace allocator
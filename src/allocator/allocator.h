@@ -21,8 +21,9 @@
 #include "core/buffer_descriptor.h"
 
 /*
- * Creates a new private_handle_t, allocates graphics memory to back it, and maps
- * the graphics memory into the process address space (excluding protected memory).
+ * Creates a new private_handle_t and allocates graphics memory to back it.
+ * Backends may leave the memory unmapped (handle->base is null); it is then mapped
+ * into the process address space with allocator_map() on first CPU access.
  *
  * The output must be destroyed by calling allocator_free, followed by
  * native_handle_close, and finally native_handle_delete.
@@ -47,6 +48,33 @@ void allocator_free(private_handle_t *handle);
 int allocator_sync_start(const private_handle_t *handle, bool read, bool write);
 int allocator_sync_end(const private_handle_t *handle, bool read, bool write);
 
+/*
+ * As allocator_sync_start/end(), limited to the bytes [offset, offset + size) of the buffer.
+ * Backends which cannot maintain a range of a buffer sync the whole of it instead, and count
+ * it in allocator_get_sync_range_fallbacks().
+ *
+ * @param handle [in]   Buffer handle
+ * @param read   [in]   Flag indicating CPU read access to memory
+ * @param write  [in]   Flag indicating CPU write access to memory
+ * @param offset [in]   Offset of the range, in bytes, from the start of the buffer
+ * @param size   [in]   Size of the range in bytes
+ *
+ * @return              0, on success; -errno, otherwise.
+ */
+int allocator_sync_range_start(const private_handle_t *handle, bool read, bool write, uint64_t offset, uint64_t size);
+int allocator_sync_range_end(const private_handle_t *handle, bool read, bool write, uint64_t offset, uint64_t size);
+
+/*
+ * Returns the number of range syncs which had to fall back to syncing the whole buffer.
+ */
+uint64_t allocator_get_sync_range_fallbacks();
+
+/*
+ * Returns the number of cache maintenance syscalls skipped because the buffer memory is not
+ * cached by the CPU, which makes them no-ops.
+ */
+uint64_t allocator_get_sync_calls_avoided();
+
 int allocator_map(private_handle_t *handle);
 void allocator_unmap(private_handle_t *handle);
 
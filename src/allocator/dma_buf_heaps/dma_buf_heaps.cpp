@@ -16,6 +16,7 @@
  * limitations under the License.
  */
 
+#include <atomic>
 #include <vector>
 #include <BufferAllocator/BufferAllocator.h>
 #include <android-base/unique_fd.h>
@@ -23,6 +24,7 @@
 #include "allocator/allocator.h"
 #include "core/buffer_allocation.h"
 #include "core/buffer_descriptor.h"
+#include "helper_functions.h"
 #include "usages.h"
 
 enum class dma_buf_heap
@@ -204,6 +206,39 @@ int allocator_sync_end(const private_handle_t *handle, bool read, bool write)
 	return allocator->CpuSyncEnd(static_cast<unsigned>(handle->share_fd), make_sync_type(read, write));
 }
 
+/*
+ * libdmabufheap only maintains caches of whole buffers, so a range sync is a whole buffer sync.
+ */
+static std::atomic<uint64_t> s_sync_range_fallbacks{0};
+
+int allocator_sync_range_start(const private_handle_t *handle, bool read, bool write, uint64_t offset, uint64_t size)
+{
+	GRALLOC_UNUSED(offset);
+	GRALLOC_UNUSED(size);
+
+	s_sync_range_fallbacks.fetch_add(1, std::memory_order_relaxed);
+	return allocator_sync_start(handle, read, write);
+}
+
+int allocator_sync_range_end(const private_handle_t *handle, bool read, bool write, uint64_t offset, uint64_t size)
+{
+	GRALLOC_UNUSED(offset);
+	GRALLOC_UNUSED(size);
+
+	s_sync_range_fallbacks.fetch_add(1, std::memory_order_relaxed);
+	return allocator_sync_end(handle, read, write);
+}
+
+uint64_t allocator_get_sync_range_fallbacks()
+{
+	return s_sync_range_fallbacks.load(std::memory_order_relaxed);
+}
+
+uint64_t allocator_get_sync_calls_avoided()
+{
+	return 0;
+}
+
 int allocator_map(private_handle_t *handle)
 {
 	void *hint = nullptr;
@@ -33,6 +33,13 @@
 #include <BufferAllocator/BufferAllocator.h>
 
 #include <linux/dma-buf.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <list>
+#include <mutex>
+#include <thread>
 #include <vector>
 #include <sys/ioctl.h>
 
@@ -46,6 +53,7 @@
 #include "usages.h"
 #include "core/buffer_descriptor.h"
 #include "core/buffer_allocation.h"
+#include "core/runtime_config.h"
 #include "allocator/allocator.h"
 
 #include <ion/ion.h>
@@ -67,6 +75,24 @@ static const char kDmabufSystemUncachedDma32HeapName[] = "system-uncached-dma32"
 
 #define DMABUF_CMA		(char*)"cma"
 
+/* Upper bound of the number of dma-bufs parked in the recycling pool. */
+#define DMABUF_POOL_MAX_ENTRIES		64
+
+/*
+ * Cache maintenance on a byte range of a dma-buf, as provided by the Rockchip kernels.
+ * It is not part of the upstream uapi header.
+ */
+#ifndef DMA_BUF_IOCTL_SYNC_PARTIAL
+struct dma_buf_sync_partial
+{
+	__u64 flags;
+	__u32 offset;
+	__u32 len;
+};
+
+#define DMA_BUF_IOCTL_SYNC_PARTIAL	_IOW(DMA_BUF_BASE, 16, struct dma_buf_sync_partial)
+#endif
+
 /* ---------------------------------------------------------------------------------------------------------
  * Local Variables
  * ---------------------------------------------------------------------------------------------------------
@@ -74,6 +100,241 @@ static const char kDmabufSystemUncachedDma32HeapName[] = "system-uncached-dma32"
 
 class BufferAllocator* s_buf_allocator;
 
+/* Set once the kernel turned out not to implement DMA_BUF_IOCTL_SYNC_PARTIAL. */
+static std::atomic<bool> s_partial_sync_unsupported{false};
+
+/* Number of range syncs which fell back to syncing the whole buffer. */
+static std::atomic<uint64_t> s_partial_sync_fallbacks{0};
+
+/* Number of sync ioctls skipped for buffers from uncached heaps. */
+static std::atomic<uint64_t> s_sync_calls_avoided{0};
+
+/*
+ * The dmabuf_heaps heaps gralloc allocates from, with the private handle flags recording
+ * the heap attributes. The heap a buffer came from can be recovered from its flags.
+ */
+static const struct
+{
+	const char *name;
+	unsigned int priv_flags;
+}
+s_heaps[] =
+{
+	{ kDmabufSystemHeapName, 0 },
+	{ kDmabufSystemUncachedHeapName, private_handle_t::PRIV_FLAGS_USES_DBH_UNCACHED },
+	{ kDmabufSystemDma32HeapName, private_handle_t::PRIV_FLAGS_USES_DBH_DMA32 },
+	{ kDmabufSystemUncachedDma32HeapName, private_handle_t::PRIV_FLAGS_USES_DBH_DMA32
+	                                      | private_handle_t::PRIV_FLAGS_USES_DBH_UNCACHED },
+	{ DMABUF_CMA, private_handle_t::PRIV_FLAGS_USES_DBH_CMA },
+};
+
+static const unsigned int s_heap_flags_mask = private_handle_t::PRIV_FLAGS_USES_DBH_CMA
+                                              | private_handle_t::PRIV_FLAGS_USES_DBH_DMA32
+                                              | private_handle_t::PRIV_FLAGS_USES_DBH_UNCACHED;
+
+/*
+ * Recycling pool of dma-bufs released by allocator_free().
+ *
+ * Camera and video pipelines free and reallocate buffers of the same few sizes at a high rate.
+ * Freed dma-bufs are parked here, keyed by (heap name, size), and handed back out to the next
+ * allocation of the same key, saving the kernel page allocation and zeroing. Allocations are not
+ * rounded up for the pool: only an exact size match is reused.
+ *
+ * Only dma-bufs whose last reference is being dropped are parked: a buffer freed by the
+ * allocator service right after sending it to a client is still in use, and is closed as
+ * before. Reuse therefore only happens in processes freeing the buffers they allocated
+ * themselves, and never for the buffers the allocator service hands out.
+ *
+ * The pool is bounded by a byte budget and by DMABUF_POOL_MAX_ENTRIES, evicting the oldest
+ * entries first, and entries not reused within the idle timeout are released by a reaper
+ * thread, whether or not allocations go on.
+ * Both are set through the runtime configuration (vendor.gralloc.dmabuf_pool_budget_kb and
+ * vendor.gralloc.dmabuf_pool_idle_timeout_ms). It is disabled when the budget is 0, which is
+ * the default.
+ */
+class dmabuf_pool
+{
+public:
+	void configure(uint64_t budget_bytes, std::chrono::milliseconds idle_timeout)
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_budget_bytes = budget_bytes;
+		m_idle_timeout = idle_timeout;
+		evict_locked(std::chrono::steady_clock::now());
+		m_reaper_cond.notify_one();
+	}
+
+	bool is_enabled() const
+	{
+		return m_budget_bytes != 0;
+	}
+
+	/*
+	 * Parks 'fd' in the pool, which takes ownership of it. The fd is closed straight away when
+	 * the dma-buf is still referenced elsewhere or does not fit.
+	 */
+	void put(const char *heap_name, int fd)
+	{
+		const off_t size = lseek(fd, 0, SEEK_END);
+		if (size <= 0 || get_dmabuf_file_count(fd) != 1)
+		{
+			close(fd);
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(m_lock);
+		if (static_cast<uint64_t>(size) > m_budget_bytes)
+		{
+			close(fd);
+			return;
+		}
+
+		m_entries.push_front({ heap_name, static_cast<uint64_t>(size), fd, std::chrono::steady_clock::now() });
+		m_parked_bytes += size;
+		evict_locked(m_entries.front().parked_at);
+
+		if (!m_reaper_started)
+		{
+			std::thread(&dmabuf_pool::reap, this).detach();
+			m_reaper_started = true;
+		}
+		m_reaper_cond.notify_one();
+	}
+
+	/*
+	 * Returns an fd of a parked dma-buf of the heap and of the page rounded 'size', or -1 when
+	 * there is none. Ownership of the fd passes to the caller.
+	 */
+	int take(const char *heap_name, uint64_t size)
+	{
+		size = round_up_to_page_size(size);
+
+		std::lock_guard<std::mutex> lock(m_lock);
+		for (auto it = m_entries.begin(); it != m_entries.end(); ++it)
+		{
+			if (it->size != size || strcmp(it->heap_name, heap_name) != 0)
+			{
+				continue;
+			}
+
+			const int fd = it->fd;
+			m_parked_bytes -= it->size;
+			m_entries.erase(it);
+			m_hits++;
+			return fd;
+		}
+
+		m_misses++;
+		return -1;
+	}
+
+	void clear()
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		while (!m_entries.empty())
+		{
+			release_oldest_locked();
+		}
+
+		if (is_enabled())
+		{
+			MALI_GRALLOC_LOGI("dmabuf pool: %" PRIu64 " hits, %" PRIu64 " misses", m_hits, m_misses);
+		}
+	}
+
+private:
+	struct entry
+	{
+		const char *heap_name;
+		uint64_t size;
+		int fd;
+		std::chrono::steady_clock::time_point parked_at;
+	};
+
+	/*
+	 * Returns the number of references to the dma-buf file behind 'fd', as reported by the kernel in
+	 * fdinfo. This includes every fd referring to it in any process, CPU mappings and device imports.
+	 * Returns -1 when the kernel does not report it, in which case the dma-buf is never reused.
+	 */
+	static long get_dmabuf_file_count(int fd)
+	{
+		char path[32];
+		snprintf(path, sizeof(path), "/proc/self/fdinfo/%d", fd);
+
+		FILE *file = fopen(path, "re");
+		if (file == nullptr)
+		{
+			return -1;
+		}
+
+		char line[64];
+		long count = -1;
+		while (fgets(line, sizeof(line), file) != nullptr)
+		{
+			if (sscanf(line, "count: %ld", &count) == 1)
+			{
+				break;
+			}
+		}
+		fclose(file);
+
+		return count;
+	}
+
+	void release_oldest_locked()
+	{
+		const entry &oldest = m_entries.back();
+		close(oldest.fd);
+		m_parked_bytes -= oldest.size;
+		m_entries.pop_back();
+	}
+
+	void evict_locked(std::chrono::steady_clock::time_point now)
+	{
+		/* Entries are kept newest first. */
+		while (!m_entries.empty()
+		       && (m_parked_bytes > m_budget_bytes
+		           || m_entries.size() > DMABUF_POOL_MAX_ENTRIES
+		           || now - m_entries.back().parked_at > m_idle_timeout))
+		{
+			release_oldest_locked();
+		}
+	}
+
+	/* Releases the entries as they reach the idle timeout. */
+	void reap()
+	{
+		std::unique_lock<std::mutex> lock(m_lock);
+		for (;;)
+		{
+			if (m_entries.empty())
+			{
+				m_reaper_cond.wait(lock);
+			}
+			else
+			{
+				m_reaper_cond.wait_until(lock, m_entries.back().parked_at + m_idle_timeout);
+			}
+			evict_locked(std::chrono::steady_clock::now());
+		}
+	}
+
+	std::mutex m_lock;
+	std::condition_variable m_reaper_cond;
+	bool m_reaper_started{false};
+	std::list<entry> m_entries;
+	uint64_t m_parked_bytes{0};
+	std::atomic<uint64_t> m_budget_bytes{0};
+	std::chrono::milliseconds m_idle_timeout{0};
+	uint64_t m_hits{0};
+	uint64_t m_misses{0};
+};
+
+/* Leaked, as its reaper thread may outlive static destruction. */
+static dmabuf_pool &s_pool = *new dmabuf_pool;
+/* Generation of the runtime configuration s_pool was configured from. */
+static std::atomic<uint32_t> s_pool_config_generation{0};
+
 /* ---------------------------------------------------------------------------------------------------------
  * Local Functions Implementation
  * ---------------------------------------------------------------------------------------------------------
@@ -81,15 +342,17 @@ class BufferAllocator* s_buf_allocator;
 
 static bool is_alloc_all_buffers_from_cma_heap_required_via_prop()
 {
-        char value[PROPERTY_VALUE_MAX];
-
-        property_get("vendor.gralloc.alloc_all_buf_from_cma_heap", value, "0");
-
-        return (0 == strcmp("1", value) );
+	return get_runtime_config().alloc_all_buffers_from_cma_heap();
 }
 
-static const char* pick_dmabuf_heap(uint64_t usage)
+/*
+ * prefer_cpu_cached: the buffer is expected to be read by the CPU often, even though its
+ * usage does not say so. See buffer_descriptor_t::prefer_cpu_cached.
+ */
+static const char* pick_dmabuf_heap(uint64_t usage, bool prefer_cpu_cached)
 {
+	const bool cpu_cached = (usage & GRALLOC_USAGE_SW_READ_MASK) == GRALLOC_USAGE_SW_READ_OFTEN || prefer_cpu_cached;
+
 	if ( is_alloc_all_buffers_from_cma_heap_required_via_prop() )
 	{
 		MALI_GRALLOC_LOGI("to allocate all buffer from cma_heap");
@@ -108,7 +371,7 @@ static const char* pick_dmabuf_heap(uint64_t usage)
 	else if ( usage & RK_GRALLOC_USAGE_WITHIN_4G )
 	{
 		MALI_GRALLOC_LOGV("allocate RK_GRALLOC_USAGE_WITHIN_4G");
-		if ( (usage & GRALLOC_USAGE_SW_READ_MASK) == GRALLOC_USAGE_SW_READ_OFTEN )
+		if ( cpu_cached )
 		{
 			return kDmabufSystemDma32HeapName; // cacheable dma32
 		}
@@ -117,7 +380,7 @@ static const char* pick_dmabuf_heap(uint64_t usage)
 			return kDmabufSystemUncachedDma32HeapName; // uncacheable dma32
 		}
 	}
-	else if ( (usage & GRALLOC_USAGE_SW_READ_MASK) == GRALLOC_USAGE_SW_READ_OFTEN )
+	else if ( cpu_cached )
 	{
 		return kDmabufSystemHeapName; // cacheable
 	}
@@ -127,6 +390,32 @@ static const char* pick_dmabuf_heap(uint64_t usage)
 	}
 }
 
+static unsigned int get_dmabuf_heap_flags(const char *heap_name)
+{
+	for (const auto &heap : s_heaps)
+	{
+		if (0 == strcmp(heap.name, heap_name))
+		{
+			return heap.priv_flags;
+		}
+	}
+
+	return 0;
+}
+
+static const char *get_dmabuf_heap_name(unsigned int priv_flags)
+{
+	for (const auto &heap : s_heaps)
+	{
+		if (heap.priv_flags == (priv_flags & s_heap_flags_mask))
+		{
+			return heap.name;
+		}
+	}
+
+	return kDmabufSystemHeapName;
+}
+
 /* 原始定义在 drivers/staging/android/uapi/ion.h 中, 这里的定义必须保持一致. */
 #define ION_FLAG_DMA32 4
 
@@ -200,6 +489,60 @@ static int call_dma_buf_sync_ioctl(int fd, uint64_t operation, bool read, bool w
 	return 0;
 }
 
+/*
+ * As call_dma_buf_sync_ioctl(), limited to the bytes [offset, offset + len) of the buffer.
+ * Falls back to syncing the whole buffer where the kernel cannot sync a range.
+ */
+static int call_dma_buf_sync_partial_ioctl(int fd, uint64_t operation, bool read, bool write,
+                                           uint32_t offset, uint32_t len)
+{
+	if (!s_partial_sync_unsupported.load(std::memory_order_relaxed))
+	{
+		dma_buf_sync_partial sync_args = { operation, offset, len };
+
+		if (read)
+		{
+			sync_args.flags |= DMA_BUF_SYNC_READ;
+		}
+
+		if (write)
+		{
+			sync_args.flags |= DMA_BUF_SYNC_WRITE;
+		}
+
+		if (ioctl(fd, DMA_BUF_IOCTL_SYNC_PARTIAL, &sync_args) == 0)
+		{
+			return 0;
+		}
+
+		if (errno == ENOTTY)
+		{
+			MALI_GRALLOC_LOGI("DMA_BUF_IOCTL_SYNC_PARTIAL is not supported, syncing whole buffers instead");
+			s_partial_sync_unsupported.store(true, std::memory_order_relaxed);
+		}
+		else
+		{
+			MALI_GRALLOC_LOGW("DMA_BUF_IOCTL_SYNC_PARTIAL(offset: %" PRIu32 ", len: %" PRIu32 ") failed: %s",
+			                  offset, len, strerror(errno));
+		}
+	}
+
+	s_partial_sync_fallbacks.fetch_add(1, std::memory_order_relaxed);
+	return call_dma_buf_sync_ioctl(fd, operation, read, write);
+}
+
+/*
+ * Buffers from the uncached heaps are mapped write-combined by the CPU, so the heaps skip
+ * cache maintenance for them. The sync ioctls still wait for the implicit fences attached
+ * to the buffer, which the Mali kernel driver may use, so they are only skipped on devices
+ * which opt in with vendor.gralloc.skip_uncached_sync.
+ */
+static bool can_skip_sync(const private_handle_t *handle)
+{
+	return (handle->flags & private_handle_t::PRIV_FLAGS_USES_DBH_UNCACHED) &&
+	       get_runtime_config().skip_uncached_sync();
+}
+
 /*---------------------------------------------------------------------------*/
 
 int allocator_sync_start(const private_handle_t *handle, bool read, bool write)
@@ -209,6 +552,12 @@ int allocator_sync_start(const private_handle_t *handle, bool read, bool write)
 		return -EINVAL;
 	}
 
+	if (can_skip_sync(handle))
+	{
+		s_sync_calls_avoided.fetch_add(1, std::memory_order_relaxed);
+		return 0;
+	}
+
 	return call_dma_buf_sync_ioctl(handle->share_fd, DMA_BUF_SYNC_START, read, write);
 }
 
@@ -219,9 +568,59 @@ int allocator_sync_end(const private_handle_t *handle, bool read, bool write)
 		return -EINVAL;
 	}
 
+	if (can_skip_sync(handle))
+	{
+		s_sync_calls_avoided.fetch_add(1, std::memory_order_relaxed);
+		return 0;
+	}
+
 	return call_dma_buf_sync_ioctl(handle->share_fd, DMA_BUF_SYNC_END, read, write);
 }
 
+int allocator_sync_range_start(const private_handle_t *handle, bool read, bool write, uint64_t offset, uint64_t size)
+{
+	if (handle == nullptr || offset + size > static_cast<uint64_t>(handle->size))
+	{
+		return -EINVAL;
+	}
+
+	if (can_skip_sync(handle))
+	{
+		s_sync_calls_avoided.fetch_add(1, std::memory_order_relaxed);
+		return 0;
+	}
+
+	return call_dma_buf_sync_partial_ioctl(handle->share_fd, DMA_BUF_SYNC_START, read, write,
+	                                       static_cast<uint32_t>(offset), static_cast<uint32_t>(size));
+}
+
+int allocator_sync_range_end(const private_handle_t *handle, bool read, bool write, uint64_t offset, uint64_t size)
+{
+	if (handle == nullptr || offset + size > static_cast<uint64_t>(handle->size))
+	{
+		return -EINVAL;
+	}
+
+	if (can_skip_sync(handle))
+	{
+		s_sync_calls_avoided.fetch_add(1, std::memory_order_relaxed);
+		return 0;
+	}
+
+	return call_dma_buf_sync_partial_ioctl(handle->share_fd, DMA_BUF_SYNC_END, read, write,
+	                                       static_cast<uint32_t>(offset), static_cast<uint32_t>(size));
+}
+
+uint64_t allocator_get_sync_range_fallbacks()
+{
+	return s_partial_sync_fallbacks.load(std::memory_order_relaxed);
+}
+
+uint64_t allocator_get_sync_calls_avoided()
+{
+	return s_sync_calls_avoided.load(std::memory_order_relaxed);
+}
+
 void allocator_free(private_handle_t *handle)
 {
 	if (handle == nullptr)
@@ -238,7 +637,15 @@ void allocator_free(private_handle_t *handle)
 		}
 	}
 
-	close(handle->share_fd);
+	if (s_pool.is_enabled() && (handle->flags & private_handle_t::PRIV_FLAGS_USES_DBH)
+	    && !((handle->producer_usage | handle->consumer_usage) & GRALLOC_USAGE_PROTECTED))
+	{
+		s_pool.put(get_dmabuf_heap_name(handle->flags), handle->share_fd);
+	}
+	else
+	{
+		close(handle->share_fd);
+	}
 	handle->share_fd = -1;
 }
 
@@ -246,6 +653,60 @@ void init_afbc(uint8_t *buf, const internal_format_t alloc_format,
                const bool is_multi_plane,
                const int w, const int h);
 
+uint32_t afbc_header_size(const int w, const int h);
+
+/*
+ * Writes the AFBC headers of a freshly allocated buffer, for every plane of every layer.
+ *
+ * Only the header region of each plane is mapped, and only for as long as it takes to write it,
+ * so the allocation does not pay for mapping (and faulting in) the whole buffer. The buffer is
+ * mapped for CPU access lazily, when it is first locked. Likewise, cache maintenance is limited
+ * to the header bytes where the kernel supports it.
+ */
+static int write_afbc_headers(const private_handle_t *handle, const buffer_descriptor_t *descriptor)
+{
+	/* For separated plane YUV, there is a header to initialise per plane. */
+	const plane_layout &plane_info = descriptor->plane_info;
+	const bool is_multi_plane = handle->is_multi_plane();
+	const uint32_t layer_count = std::max(descriptor->layer_count, 1u);
+	const uint64_t layer_size = descriptor->size / layer_count;
+	const off_t page_mask = static_cast<off_t>(getpagesize()) - 1;
+
+	for (uint32_t layer = 0; layer < layer_count; layer++)
+	{
+		for (int i = 0; i < max_planes && (i == 0 || plane_info[i].byte_stride != 0); i++)
+		{
+			const uint32_t header_size = afbc_header_size(plane_info[i].alloc_width, plane_info[i].alloc_height);
+			const off_t header_start = layer * layer_size + plane_info[i].offset;
+			const off_t map_offset = header_start & ~page_mask;
+			const size_t header_offset = header_start - map_offset;
+			const size_t map_size = round_up_to_page_size(header_offset + header_size);
+
+			void *mapping = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, handle->share_fd, map_offset);
+			if (MAP_FAILED == mapping)
+			{
+				MALI_GRALLOC_LOGE("mmap of AFBC header (share_fd = %d, offset = %" PRId64 ") failed: %s",
+				                  handle->share_fd, static_cast<int64_t>(map_offset), strerror(errno));
+				return -errno;
+			}
+
+			allocator_sync_range_start(handle, true, true, header_start, header_size);
+
+			init_afbc(static_cast<uint8_t *>(mapping) + header_offset,
+			          descriptor->alloc_format,
+			          is_multi_plane,
+			          plane_info[i].alloc_width,
+			          plane_info[i].alloc_height);
+
+			allocator_sync_range_end(handle, true, true, header_start, header_size);
+
+			munmap(mapping, map_size);
+		}
+	}
+
+	return 0;
+}
+
 int allocator_allocate(const buffer_descriptor_t *descriptor, private_handle_t **out_handle)
 {
 	unsigned int priv_heap_flag = private_handle_t::PRIV_FLAGS_USES_DBH;
@@ -254,6 +715,7 @@ int allocator_allocate(const buffer_descriptor_t *descriptor, private_handle_t *
 	private_handle_t *handle = nullptr;
 	int ret = 0;
 	private_handle_t* hnd= nullptr; // 'handle' 的别名.
+	bool is_recycled = false;
 
 	if ( NULL == s_buf_allocator )
 	{
@@ -272,12 +734,37 @@ int allocator_allocate(const buffer_descriptor_t *descriptor, private_handle_t *
 		}
         }
 
+	/* (Re)configure the recycling pool whenever the runtime configuration changed. */
+	{
+		const runtime_config &config = get_runtime_config();
+		const uint32_t config_generation = config.generation();
+		if (config_generation != s_pool_config_generation)
+		{
+			s_pool.configure(config.dmabuf_pool_budget_bytes(),
+			                 std::chrono::milliseconds(config.dmabuf_pool_idle_timeout_ms()));
+			s_pool_config_generation = config_generation;
+		}
+	}
+
 	usage = descriptor->consumer_usage | descriptor->producer_usage;
 
-	const char* heap_name = pick_dmabuf_heap(usage);
+	const char* heap_name = pick_dmabuf_heap(usage, descriptor->prefer_cpu_cached);
+	if (heap_name == NULL)
+	{
+		return -EINVAL;
+	}
+	priv_heap_flag |= get_dmabuf_heap_flags(heap_name);
 
-	android::base::unique_fd shared_fd{
-		s_buf_allocator->Alloc(heap_name, descriptor->size)};
+	android::base::unique_fd shared_fd;
+	if (s_pool.is_enabled())
+	{
+		shared_fd.reset(s_pool.take(heap_name, descriptor->size));
+		is_recycled = (shared_fd >= 0);
+	}
+	if (shared_fd < 0)
+	{
+		shared_fd.reset(s_buf_allocator->Alloc(heap_name, descriptor->size));
+	}
 	if (shared_fd < 0)
 	{
 		MALI_GRALLOC_LOGE("Alloc failed.");
@@ -315,11 +802,21 @@ int allocator_allocate(const buffer_descriptor_t *descriptor, private_handle_t *
 		goto success;
 	}
 
-	ret = allocator_map(handle);
-	if (ret != 0)
+	if (is_recycled)
 	{
-		MALI_GRALLOC_LOGE("mmap failed, fd ( %d )", handle->share_fd);
-		goto fail;
+		/* A recycled buffer still holds the content of its previous user. */
+		ret = allocator_map(handle);
+		if (ret != 0)
+		{
+			MALI_GRALLOC_LOGE("mmap failed, fd ( %d )", handle->share_fd);
+			goto fail;
+		}
+
+		allocator_sync_start(handle, false, true);
+		memset(handle->base, 0, handle->size);
+		allocator_sync_end(handle, false, true);
+
+		allocator_unmap(handle);
 	}
 
 #ifndef GRALLOC_INIT_AFBC
@@ -327,21 +824,11 @@ int allocator_allocate(const buffer_descriptor_t *descriptor, private_handle_t *
 #endif
 	if (descriptor->alloc_format.is_afbc())
 	{
-		allocator_sync_start(handle, true, true);
-
-		/* For separated plane YUV, there is a header to initialise per plane. */
-		const plane_layout plane_info = descriptor->plane_info;
-		const bool is_multi_plane = handle->is_multi_plane();
-		for (int i = 0; i < max_planes && (i == 0 || plane_info[i].byte_stride != 0); i++)
+		ret = write_afbc_headers(handle, descriptor);
+		if (ret != 0)
 		{
-			init_afbc(static_cast<uint8_t *>(handle->base) + plane_info[i].offset,
-			          descriptor->alloc_format,
-			          is_multi_plane,
-			          plane_info[i].alloc_width,
-			          plane_info[i].alloc_height);
+			goto fail;
 		}
-
-		allocator_sync_end(handle, true, true);
 	}
 success:
 	*out_handle = handle;
@@ -356,6 +843,40 @@ fail:
 	return ret;
 }
 
+/* Alignment of the mappings of prefaulted buffers, for the heaps which map large pages. */
+#define LARGE_PAGE_SIZE (2 * 1024 * 1024)
+
+/*
+ * Reserves 'size' bytes of address space starting on a LARGE_PAGE_SIZE boundary, for the
+ * buffer to be mapped over with MAP_FIXED.
+ *
+ * @return The start of the reservation; nullptr when no address space could be reserved.
+ */
+static void *get_large_page_aligned_hint(const size_t size)
+{
+	const size_t reserved_size = size + LARGE_PAGE_SIZE;
+	void *reservation = mmap(nullptr, reserved_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (reservation == MAP_FAILED)
+	{
+		return nullptr;
+	}
+
+	const uintptr_t start = reinterpret_cast<uintptr_t>(reservation);
+	const uintptr_t aligned = GRALLOC_ALIGN(start, LARGE_PAGE_SIZE);
+	if (aligned > start)
+	{
+		munmap(reservation, aligned - start);
+	}
+
+	const uintptr_t end = aligned + GRALLOC_ALIGN(size, static_cast<size_t>(getpagesize()));
+	if (start + reserved_size > end)
+	{
+		munmap(reinterpret_cast<void *>(end), start + reserved_size - end);
+	}
+
+	return reinterpret_cast<void *>(aligned);
+}
+
 int allocator_map(private_handle_t *handle)
 {
 	if (handle == nullptr)
@@ -367,7 +888,30 @@ int allocator_map(private_handle_t *handle)
 	int protection = PROT_READ | PROT_WRITE;
 	int flags = MAP_SHARED;
 	off_t page_offset = 0;
+
+	/*
+	 * See RK_GRALLOC_USAGE_PREFAULT_MAPPING. The buffer replaces the aligned reservation, so
+	 * that heaps allocating large pages can map them with block entries. Heaps which cannot
+	 * simply map the buffer at the aligned address with small pages.
+	 */
+	const bool prefault = ((handle->producer_usage | handle->consumer_usage) & RK_GRALLOC_USAGE_PREFAULT_MAPPING) ||
+	                      get_runtime_config().prefault_mappings();
+	if (prefault && handle->size >= LARGE_PAGE_SIZE)
+	{
+		hint = get_large_page_aligned_hint(handle->size);
+		if (hint != nullptr)
+		{
+			flags |= MAP_FIXED;
+		}
+	}
+
 	void *mapping = mmap(hint, handle->size, protection, flags, handle->share_fd, page_offset);
+	if (MAP_FAILED == mapping && hint != nullptr)
+	{
+		/* Fall back to a mapping anywhere. */
+		munmap(hint, handle->size);
+		mapping = mmap(nullptr, handle->size, protection, MAP_SHARED, handle->share_fd, page_offset);
+	}
 	if (MAP_FAILED == mapping)
 	{
 		MALI_GRALLOC_LOGE("mmap(share_fd = %d) failed: %s", handle->share_fd, strerror(errno));
@@ -399,6 +943,6 @@ void allocator_unmap(private_handle_t *handle)
 
 void allocator_close(void)
 {
-	return;
+	s_pool.clear();
 }
 
@@ -32,6 +32,7 @@
 #include <ion/ion.h>
 #include <linux/ion_4.12.h>
 #include <linux/dma-buf.h>
+#include <atomic>
 #include <vector>
 #include <sys/ioctl.h>
 
@@ -408,6 +409,39 @@ int allocator_sync_end(const private_handle_t *handle, bool read, bool write)
 	return call_dma_buf_sync_ioctl(handle->share_fd, DMA_BUF_SYNC_END, read, write);
 }
 
+/*
+ * ION only maintains caches of whole buffers, so a range sync is a whole buffer sync.
+ */
+static std::atomic<uint64_t> s_sync_range_fallbacks{0};
+
+int allocator_sync_range_start(const private_handle_t *handle, bool read, bool write, uint64_t offset, uint64_t size)
+{
+	GRALLOC_UNUSED(offset);
+	GRALLOC_UNUSED(size);
+
+	s_sync_range_fallbacks.fetch_add(1, std::memory_order_relaxed);
+	return allocator_sync_start(handle, read, write);
+}
+
+int allocator_sync_range_end(const private_handle_t *handle, bool read, bool write, uint64_t offset, uint64_t size)
+{
+	GRALLOC_UNUSED(offset);
+	GRALLOC_UNUSED(size);
+
+	s_sync_range_fallbacks.fetch_add(1, std::memory_order_relaxed);
+	return allocator_sync_end(handle, read, write);
+}
+
+uint64_t allocator_get_sync_range_fallbacks()
+{
+	return s_sync_range_fallbacks.load(std::memory_order_relaxed);
+}
+
+uint64_t allocator_get_sync_calls_avoided()
+{
+	return 0;
+}
+
 void allocator_free(private_handle_t *handle)
 {
 	if (handle == nullptr)
@@ -0,0 +1,231 @@
+/*
+ * Copyright (C) 2022 Arm Limited. All rights reserved.
+ *
+ * Copyright (C) 2008 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Allocator backed by anonymous shared memory files (memfd).
+ *
+ * The memory is ordinary cacheable system memory which is not accessible by any device,
+ * so this backend is only suited to host builds and to benchmarking the allocation and
+ * lock paths of gralloc without the target hardware.
+ */
+
+#include <sys/syscall.h>
+#include <linux/memfd.h>
+#include <fcntl.h>
+
+#include <algorithm>
+
+#include <android-base/unique_fd.h>
+
+#include "allocator/allocator.h"
+#include "core/buffer_allocation.h"
+#include "core/buffer_descriptor.h"
+#include "helper_functions.h"
+#include "usages.h"
+
+void init_afbc(uint8_t *buf, const internal_format_t alloc_format,
+               const bool is_multi_plane,
+               const int w, const int h);
+
+static int create_buffer_file(uint64_t size)
+{
+	android::base::unique_fd fd{static_cast<int>(syscall(__NR_memfd_create, "gralloc_buffer", MFD_ALLOW_SEALING))};
+	if (fd < 0)
+	{
+		MALI_GRALLOC_LOGE("memfd_create: %s", strerror(errno));
+		return -errno;
+	}
+
+	if (ftruncate(fd, static_cast<off_t>(size)) < 0)
+	{
+		MALI_GRALLOC_LOGE("ftruncate: %s", strerror(errno));
+		return -errno;
+	}
+
+	/* Buffers have a fixed size for their whole lifetime, like dma-bufs. */
+	if (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0)
+	{
+		MALI_GRALLOC_LOGE("Failed to seal fd: %s", strerror(errno));
+		return -errno;
+	}
+
+	return fd.release();
+}
+
+int allocator_allocate(const buffer_descriptor_t *descriptor, private_handle_t **out_handle)
+{
+	uint64_t usage = descriptor->consumer_usage | descriptor->producer_usage;
+	if (usage & GRALLOC_USAGE_PROTECTED)
+	{
+		MALI_GRALLOC_LOGE("Protected memory is not supported by the memfd allocator");
+		return -EINVAL;
+	}
+
+	int fd = create_buffer_file(descriptor->size);
+	if (fd < 0)
+	{
+		return -ENOMEM;
+	}
+
+	private_handle_t *handle = make_private_handle(
+	    0, descriptor->size,
+	    descriptor->consumer_usage, descriptor->producer_usage, android::base::unique_fd{fd}, descriptor->hal_format,
+	    descriptor->alloc_format, descriptor->width, descriptor->height, descriptor->size, descriptor->layer_count,
+	    descriptor->plane_info, descriptor->pixel_stride);
+	if (nullptr == handle)
+	{
+		MALI_GRALLOC_LOGE("Private handle could not be created for descriptor");
+		return -ENOMEM;
+	}
+
+	int ret = allocator_map(handle);
+	if (ret != 0)
+	{
+		allocator_free(handle);
+		native_handle_delete(handle);
+		return ret;
+	}
+
+	if (descriptor->alloc_format.is_afbc())
+	{
+		/* For separated plane YUV, there is a header to initialise per plane, in every layer. */
+		const plane_layout &plane_info = descriptor->plane_info;
+		const bool is_multi_plane = handle->is_multi_plane();
+		const uint32_t layer_count = std::max(descriptor->layer_count, 1u);
+		const uint64_t layer_size = descriptor->size / layer_count;
+		for (uint32_t layer = 0; layer < layer_count; layer++)
+		{
+			uint8_t *layer_base = static_cast<uint8_t *>(handle->base) + layer * layer_size;
+			for (int i = 0; i < max_planes && (i == 0 || plane_info[i].byte_stride != 0); i++)
+			{
+				init_afbc(layer_base + plane_info[i].offset,
+				          descriptor->alloc_format,
+				          is_multi_plane,
+				          plane_info[i].alloc_width,
+				          plane_info[i].alloc_height);
+			}
+		}
+	}
+
+	*out_handle = handle;
+	return 0;
+}
+
+void allocator_free(private_handle_t *handle)
+{
+	if (handle == nullptr)
+	{
+		return;
+	}
+
+	if (handle->base != nullptr)
+	{
+		munmap(handle->base, handle->size);
+	}
+
+	close(handle->share_fd);
+	handle->share_fd = -1;
+}
+
+/*
+ * memfd memory is only ever accessed by the CPU, through coherent mappings, so there is
+ * no cache maintenance to do.
+ */
+int allocator_sync_start(const private_handle_t *handle, bool read, bool write)
+{
+	GRALLOC_UNUSED(read);
+	GRALLOC_UNUSED(write);
+
+	return handle == nullptr ? -EINVAL : 0;
+}
+
+int allocator_sync_end(const private_handle_t *handle, bool read, bool write)
+{
+	GRALLOC_UNUSED(read);
+	GRALLOC_UNUSED(write);
+
+	return handle == nullptr ? -EINVAL : 0;
+}
+
+int allocator_sync_range_start(const private_handle_t *handle, bool read, bool write, uint64_t offset, uint64_t size)
+{
+	GRALLOC_UNUSED(offset);
+	GRALLOC_UNUSED(size);
+
+	return allocator_sync_start(handle, read, write);
+}
+
+int allocator_sync_range_end(const private_handle_t *handle, bool read, bool write, uint64_t offset, uint64_t size)
+{
+	GRALLOC_UNUSED(offset);
+	GRALLOC_UNUSED(size);
+
+	return allocator_sync_end(handle, read, write);
+}
+
+uint64_t allocator_get_sync_range_fallbacks()
+{
+	return 0;
+}
+
+uint64_t allocator_get_sync_calls_avoided()
+{
+	return 0;
+}
+
+int allocator_map(private_handle_t *handle)
+{
+	if (handle == nullptr)
+	{
+		return -EINVAL;
+	}
+
+	void *mapping = mmap(nullptr, handle->size, PROT_READ | PROT_WRITE, MAP_SHARED, handle->share_fd, 0);
+	if (MAP_FAILED == mapping)
+	{
+		MALI_GRALLOC_LOGE("mmap(share_fd = %d) failed: %s", handle->share_fd, strerror(errno));
+		return -errno;
+	}
+
+	handle->base = static_cast<std::byte *>(mapping);
+
+	return 0;
+}
+
+void allocator_unmap(private_handle_t *handle)
+{
+	if (handle == nullptr)
+	{
+		return;
+	}
+
+	void *base = static_cast<std::byte *>(handle->base);
+	if (munmap(base, handle->size) < 0)
+	{
+		MALI_GRALLOC_LOGE("munmap(base = %p, size = %d) failed: %s", base, handle->size, strerror(errno));
+	}
+
+	handle->base = nullptr;
+	handle->cpu_write = false;
+	handle->lock_count = 0;
+}
+
+void allocator_close()
+{
+	/* nop */
+}
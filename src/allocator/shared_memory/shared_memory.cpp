@@ -19,10 +19,12 @@
 #include <sys/syscall.h>
 #include <linux/memfd.h>
 #include <fcntl.h>
+#include <unistd.h>
 
 #include "shared_memory.h"
 #include "log.h"
 #include "buffer.h"
+#include "helper_functions.h"
 
 static int create_file(const char *name, uint64_t size)
 {
@@ -103,12 +105,17 @@ fail:
 	return std::make_pair(-1, MAP_FAILED);
 }
 
-void gralloc_shared_memory_free(int fd, void *mapping, uint64_t size)
+void gralloc_shared_memory_unmap(void *mapping, uint64_t size)
 {
 	if (mapping != MAP_FAILED)
 	{
 		munmap(mapping, size);
 	}
+}
+
+void gralloc_shared_memory_free(int fd, void *mapping, uint64_t size)
+{
+	gralloc_shared_memory_unmap(mapping, size);
 
 	if (fd >= 0)
 	{
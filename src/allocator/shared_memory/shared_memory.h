@@ -34,6 +34,12 @@
  */
 std::pair<int, void *> gralloc_shared_memory_allocate(const char *name, uint64_t size);
 
+/*
+ * Unmaps a region acquired from gralloc_shared_memory_allocate, leaving its file descriptor
+ * open.
+ */
+void gralloc_shared_memory_unmap(void *mapping, uint64_t size);
+
 /*
  * Frees resources acquired from gralloc_shared_memory_allocate.
  */
@@ -120,13 +120,25 @@ struct private_handle_t : public native_handle
 
 		/* allocated from dmabuf_heaps. */
 		PRIV_FLAGS_USES_DBH = 1 << 6,
+
+		/*
+		 * Attributes of the dmabuf_heaps heap the buffer was allocated from.
+		 * Only meaningful together with PRIV_FLAGS_USES_DBH.
+		 */
+		PRIV_FLAGS_USES_DBH_CMA = 1 << 7,
+		PRIV_FLAGS_USES_DBH_DMA32 = 1 << 8,
+		PRIV_FLAGS_USES_DBH_UNCACHED = 1 << 9,
 	};
 
+	/* Bits of lock_state. */
 	enum
 	{
 		LOCK_STATE_WRITE = 1 << 31,
 		LOCK_STATE_MAPPED = 1 << 30,
-		LOCK_STATE_READ_MASK = 0x3FFFFFFF
+		/* A thread is changing the state of the buffer; others wait for it to finish. */
+		LOCK_STATE_BUSY = 1 << 29,
+		/* Number of outstanding CPU locks, for read or write. */
+		LOCK_STATE_READ_MASK = 0x1FFFFFFF
 	};
 
 	/*
@@ -210,6 +222,21 @@ struct private_handle_t : public native_handle
 
 	uint64_t imapper_version{};
 
+	/*
+	 * CPU lock state, local to the process: it is reset when the handle is imported. It comes
+	 * after the fields shared with other processes, so that their offsets do not depend on it.
+	 *
+	 * lock_state:  LOCK_STATE_* bits.
+	 * lock_left/top/right/bottom: Bounding box, in pixels, of the access regions of the
+	 *              outstanding CPU locks. Cache maintenance is limited to the bytes it covers.
+	 *              Empty when not locked.
+	 */
+	std::atomic<int> lock_state{};
+	int lock_left{};
+	int lock_top{};
+	int lock_right{};
+	int lock_bottom{};
+
 	/**
 	 * This magic number is used to check that the native_handle passed to Gralloc is our private_handle_t type.
 	 * The value is chosen arbitrarily.
@@ -273,6 +300,15 @@ struct private_handle_t : public native_handle
 static_assert(MALI_GRALLOC_HANDLE_WIDTH_OFFSET == offsetof(private_handle_t, width));
 static_assert(MALI_GRALLOC_HANDLE_HEIGHT_OFFSET == offsetof(private_handle_t, height));
 
+/*
+ * Number of ints of the handles allocated by earlier gralloc releases, which end before the CPU
+ * lock state. The mapper extends them to PRIVATE_HANDLE_NUM_INTS when they are imported.
+ */
+#define PRIVATE_HANDLE_LEGACY_NUM_INTS \
+	((offsetof(private_handle_t, lock_state) - sizeof(native_handle_t)) / sizeof(int) - PRIVATE_HANDLE_NUM_FDS)
+static_assert(offsetof(private_handle_t, lock_state) == offsetof(private_handle_t, imapper_version) + sizeof(uint64_t),
+              "the CPU lock state must follow the fields of the legacy handles");
+
 private_handle_t *make_private_handle(int flags, int size, uint64_t consumer_usage, uint64_t producer_usage,
                                       android::base::unique_fd shared_fd, int required_format,
                                       internal_format_t allocated_format, int width, int height,
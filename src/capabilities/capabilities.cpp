@@ -25,67 +25,115 @@
 
 #include "xml_configuration.h"
 
-static bool caps_supports_feature_cpu(const std::string &feature_name)
-{
-	if (feature_name == "FORMAT_R10G10B10A2")
-	{
-		return true;
-	}
-	if (feature_name == "FORMAT_R16G16B16A16_FLOAT")
-	{
-		return true;
-	}
-	return false;
-}
+/* Features the CPU supports, for both reading and writing. */
+static const capability_mask cpu_features = capability_bit(capability_feature::FORMAT_R10G10B10A2) |
+                                            capability_bit(capability_feature::FORMAT_R16G16B16A16_FLOAT);
 
-bool ip_support_feature(mali_gralloc_ip producers, mali_gralloc_ip consumers, const char *name)
+/* Number of distinct sets of IPs, MALI_GRALLOC_IP_CAM being the highest IP bit. */
+static constexpr size_t ip_set_count = MALI_GRALLOC_IP_CAM << 1;
+
+/*
+ * The capabilities of every IP compiled into, for each possible set of producers (consumers),
+ * the features all of them can write (read). A feature query is then a single AND.
+ */
+class ip_feature_table
 {
-	static ip_capability capability_handles[] = {
-		/* clang-format off */
-		{ MALI_GRALLOC_IP_GPU, "gpu" },
-		{ MALI_GRALLOC_IP_DPU, "dpu" },
-		{ MALI_GRALLOC_IP_DPU_AEU, "dpu_aeu" },
-		{ MALI_GRALLOC_IP_VPU, "vpu" },
-		{ MALI_GRALLOC_IP_CAM, "cam" },
-		/* clang-format on */
-	};
-
-	if ((producers & MALI_GRALLOC_IP_CPU || consumers & MALI_GRALLOC_IP_CPU) && !caps_supports_feature_cpu(name))
+public:
+	ip_feature_table()
 	{
-		MALI_GRALLOC_LOGV("Feature %s not supported on CPU", name);
-		return false;
-	}
+		static ip_capability capability_handles[] = {
+			/* clang-format off */
+			{ MALI_GRALLOC_IP_GPU, "gpu" },
+			{ MALI_GRALLOC_IP_DPU, "dpu" },
+			{ MALI_GRALLOC_IP_DPU_AEU, "dpu_aeu" },
+			{ MALI_GRALLOC_IP_VPU, "vpu" },
+			{ MALI_GRALLOC_IP_CAM, "cam" },
+			/* clang-format on */
+		};
 
-	for (auto &handle : capability_handles)
-	{
-		/* We handle a missing IP by posing no restrictions for that IP on format allocation. */
-		if (!handle.caps_have_value())
+		/* IPs without capabilities pose no restrictions on format allocation. */
+		capability_mask write_features[ip_set_count] = {};
+		capability_mask read_features[ip_set_count] = {};
+		for (mali_gralloc_ip ip = 1; ip < ip_set_count; ip <<= 1)
 		{
-			LOG_ALWAYS_FATAL_IF(!strcmp(name, "gpu"), "gpu.xml not found.");
-			continue;
+			write_features[ip] = capability_mask_all;
+			read_features[ip] = capability_mask_all;
 		}
 
-		auto ip = handle.get_ip();
-		if (producers & ip)
+		write_features[MALI_GRALLOC_IP_CPU] = cpu_features;
+		read_features[MALI_GRALLOC_IP_CPU] = cpu_features;
+		m_restricting_ips = MALI_GRALLOC_IP_CPU;
+
+		for (auto &handle : capability_handles)
 		{
-			if (!handle.is_feature_supported(name, ip_capability::permission_t::write))
+			if (!handle.caps_have_value())
 			{
-				MALI_GRALLOC_LOGV("Feature %s not supported on producer %s", name, handle.get_path());
-				return false;
+				continue;
 			}
+
+			const auto ip = handle.get_ip();
+			write_features[ip] = handle.get_features(ip_capability::permission_t::write);
+			read_features[ip] = handle.get_features(ip_capability::permission_t::read);
+			m_restricting_ips |= ip;
 		}
 
-		if (consumers & ip)
+		for (size_t ips = 0; ips < ip_set_count; ips++)
 		{
-			if (!handle.is_feature_supported(name, ip_capability::permission_t::read))
+			m_producer_features[ips] = capability_mask_all;
+			m_consumer_features[ips] = capability_mask_all;
+			for (mali_gralloc_ip ip = 1; ip < ip_set_count; ip <<= 1)
 			{
-				MALI_GRALLOC_LOGV("Feature %s not supported on consumer %s", name, handle.get_path());
-				return false;
+				if (ips & ip)
+				{
+					m_producer_features[ips] &= write_features[ip];
+					m_consumer_features[ips] &= read_features[ip];
+				}
 			}
 		}
 	}
 
-	return true;
+	bool support(mali_gralloc_ip producers, mali_gralloc_ip consumers, capability_feature feature) const
+	{
+		return (m_producer_features[producers & (ip_set_count - 1)] &
+		        m_consumer_features[consumers & (ip_set_count - 1)] & capability_bit(feature)) != 0;
+	}
+
+	/*
+	 * Whether any of the IPs restricts features at all. Those which do not support features
+	 * Gralloc does not know of.
+	 */
+	bool restricts(mali_gralloc_ip ips) const
+	{
+		return (ips & m_restricting_ips) != 0;
+	}
+
+private:
+	capability_mask m_producer_features[ip_set_count];
+	capability_mask m_consumer_features[ip_set_count];
+	mali_gralloc_ip m_restricting_ips;
+};
+
+static const ip_feature_table &get_ip_feature_table()
+{
+	static const ip_feature_table table;
+	return table;
+}
+
+bool ip_support_feature(mali_gralloc_ip producers, mali_gralloc_ip consumers, capability_feature feature)
+{
+	return get_ip_feature_table().support(producers, consumers, feature);
+}
+
+bool ip_support_feature(mali_gralloc_ip producers, mali_gralloc_ip consumers, const char *name)
+{
+	const auto feature = find_capability_feature(name);
+	if (!feature.has_value())
+	{
+		MALI_GRALLOC_LOGV("Feature %s is unknown", name);
+		return !get_ip_feature_table().restricts(producers | consumers);
+	}
+
+	return ip_support_feature(producers, consumers, *feature);
 }
 
 /* This is used by the unit tests to get the capabilities for each IP. */
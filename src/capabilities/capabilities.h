@@ -20,10 +20,12 @@
 #include <inttypes.h>
 #include <string>
 #include "gralloc/formats.h"
+#include "capability_features.h"
 
 class producers_t;
 class consumers_t;
 
+bool ip_support_feature(mali_gralloc_ip producers, mali_gralloc_ip consumers, capability_feature feature);
 bool ip_support_feature(mali_gralloc_ip producers, mali_gralloc_ip consumers, const char *name);
 
 /**
@@ -42,15 +44,15 @@ public:
 	 *
 	 * @param producers A set of producers.
 	 * @param consumers A set of consumers.
-	 * @param name Name of the feature.
-	 * @return Whether the feature @p name is supported by all of @p producers and @p consumers.
+	 * @param feature The feature.
+	 * @return Whether the feature @p feature is supported by all of @p producers and @p consumers.
 	 *   If @p producers or @p consumers are empty, then they are ignored.
-	 *   For example, if @p producers is empty then this function checks whether @p name is
+	 *   For example, if @p producers is empty then this function checks whether @p feature is
 	 *   supported by all consumers only. If @p producers and @p consumers are both empty, this
 	 *   function returns unconditionally @c true. Similarly, producers and consumers that are
 	 *   not present (see ip_t::present for a definition of "present") are also ignored.
 	 */
-	static bool support(producers_t producers, consumers_t consumers, const char *name);
+	static bool support(producers_t producers, consumers_t consumers, capability_feature feature);
 
 	/**
 	 * @brief Check whether the provided IPs are present in the system.
@@ -105,9 +107,9 @@ class producers_t : public ip_t
 public:
 	using ip_t::ip_t;
 
-	bool support(const char *name) const
+	bool support(capability_feature feature) const
 	{
-		return ip_support_feature(get(), MALI_GRALLOC_IP_NONE, name);
+		return ip_support_feature(get(), MALI_GRALLOC_IP_NONE, feature);
 	}
 };
 
@@ -119,15 +121,15 @@ class consumers_t : public ip_t
 public:
 	using ip_t::ip_t;
 
-	bool support(const char *name) const
+	bool support(capability_feature feature) const
 	{
-		return ip_support_feature(MALI_GRALLOC_IP_NONE, get(), name);
+		return ip_support_feature(MALI_GRALLOC_IP_NONE, get(), feature);
 	}
 };
 
-inline bool ip_t::support(producers_t producers, consumers_t consumers, const char *name)
+inline bool ip_t::support(producers_t producers, consumers_t consumers, capability_feature feature)
 {
-	return ip_support_feature(producers.get(), consumers.get(), name);
+	return ip_support_feature(producers.get(), consumers.get(), feature);
 }
 
 inline bool ip_t::present(ip_t ips)
@@ -138,7 +140,7 @@ inline bool ip_t::present(ip_t ips)
 		 * - ip is not found in the configuration files
 		 * - ip is explictly marked as disabled in the configuration files for both read/write
 		 */
-		if (ips.contains(ip) && ip_support_feature(ip, ip, "DISABLED"))
+		if (ips.contains(ip) && ip_support_feature(ip, ip, capability_feature::DISABLED))
 		{
 			return false;
 		}
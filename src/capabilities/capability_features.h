@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2022 Arm Limited.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <iterator>
+#include <optional>
+#include <stdint.h>
+#include <string_view>
+
+/*
+ * Features of the capabilities files which Gralloc queries.
+ *
+ * The enumerators index the names in capability_feature_names, which must match the feature
+ * names used in the capabilities files. Features found in the files but not listed here are
+ * never queried and therefore ignored.
+ */
+enum class capability_feature : uint32_t
+{
+	AFBC_16X16,
+	AFBC_32X8,
+	AFBC_64X4,
+	AFBC_BLOCK_SPLIT,
+	AFBC_DOUBLE_BODY,
+	AFBC_FORMAT_R16G16B16A16_FLOAT,
+	AFBC_TILED_HEADERS,
+	AFBC_WRITE_NON_SPARSE,
+	AFBC_YUV,
+	AFRC_ROT_LAYOUT,
+	AFRC_SCAN_LAYOUT,
+	DISABLED,
+	FORMAT_R10G10B10A2,
+	FORMAT_R16G16B16A16_FLOAT,
+	YUV_BL_8,
+	YUV_BL_10,
+
+	count
+};
+
+constexpr std::string_view capability_feature_names[] = {
+	"AFBC_16X16",
+	"AFBC_32X8",
+	"AFBC_64X4",
+	"AFBC_BLOCK_SPLIT",
+	"AFBC_DOUBLE_BODY",
+	"AFBC_FORMAT_R16G16B16A16_FLOAT",
+	"AFBC_TILED_HEADERS",
+	"AFBC_WRITE_NON_SPARSE",
+	"AFBC_YUV",
+	"AFRC_ROT_LAYOUT",
+	"AFRC_SCAN_LAYOUT",
+	"DISABLED",
+	"FORMAT_R10G10B10A2",
+	"FORMAT_R16G16B16A16_FLOAT",
+	"YUV_BL_8",
+	"YUV_BL_10",
+};
+
+static_assert(std::size(capability_feature_names) == static_cast<size_t>(capability_feature::count));
+
+/* Set of features, one bit per capability_feature. */
+using capability_mask = uint32_t;
+
+static_assert(static_cast<size_t>(capability_feature::count) <= sizeof(capability_mask) * 8);
+
+constexpr capability_mask capability_mask_all = ~capability_mask{0};
+
+constexpr capability_mask capability_bit(capability_feature feature)
+{
+	return capability_mask{1} << static_cast<uint32_t>(feature);
+}
+
+inline std::optional<capability_feature> find_capability_feature(std::string_view name)
+{
+	for (size_t i = 0; i < std::size(capability_feature_names); i++)
+	{
+		if (capability_feature_names[i] == name)
+		{
+			return static_cast<capability_feature>(i);
+		}
+	}
+	return std::nullopt;
+}
@@ -0,0 +1,134 @@
+#!/usr/bin/env python3
+
+# Copyright (C) 2022 Arm Limited.
+# SPDX-License-Identifier: Apache-2.0
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+# This script turns the IP capabilities files (see interfaces/capabilities/capabilities_type.xsd)
+# of a device into capabilities_generated.h, so that Gralloc can be built with the capabilities
+# compiled in instead of parsing /vendor/etc/gralloc/<ip>.xml at runtime.
+#
+# Usage:
+#   gen_capabilities_header.py -o src/capabilities/capabilities_generated.h gpu.xml dpu.xml ...
+#
+# The IP of each file is taken from its base name (gpu, dpu, dpu_aeu, vpu or cam), as at runtime.
+# Then set GRALLOC_GENERATED_CAPABILITIES=1 in the board configuration (see gralloc.device.mk).
+
+import argparse
+import os
+import sys
+import xml.etree.ElementTree as ET
+
+IPS = ("gpu", "dpu", "dpu_aeu", "vpu", "cam")
+PERMISSIONS = {
+    "RW": ("true", "true"),
+    "RO": ("true", "false"),
+    "WO": ("false", "true"),
+    "NO": ("false", "false"),
+}
+
+
+def read_features(path):
+    root = ET.parse(path).getroot()
+    if root.tag != "capabilities":
+        raise ValueError("%s: root element is <%s>, expected <capabilities>" % (path, root.tag))
+
+    features = []
+    for feature in root.iter("feature"):
+        name = feature.get("name")
+        permission = feature.get("permission")
+        if not name or permission not in PERMISSIONS:
+            raise ValueError("%s: invalid feature name=%r permission=%r" % (path, name, permission))
+        features.append((name, PERMISSIONS[permission]))
+    return features
+
+
+def generate(files):
+    lines = [
+        "/*",
+        " * Generated by gen_capabilities_header.py from:",
+    ]
+    lines += [" *   %s" % os.path.basename(path) for _, path in files]
+    lines += [
+        " *",
+        " * DO NOT EDIT.",
+        " */",
+        "",
+        "#pragma once",
+        "",
+        "#include <stddef.h>",
+        "",
+        "struct generated_capability_feature",
+        "{",
+        "\tconst char *name;",
+        "\tbool readable;",
+        "\tbool writeable;",
+        "};",
+        "",
+        "struct generated_capabilities",
+        "{",
+        "\tconst char *ip;",
+        "\tconst generated_capability_feature *features;",
+        "\tsize_t feature_count;",
+        "};",
+        "",
+    ]
+
+    entries = []
+    for ip, path in files:
+        features = read_features(path)
+        if not features:
+            entries.append('\t{ "%s", nullptr, 0 },' % ip)
+            continue
+
+        lines.append("static const generated_capability_feature generated_%s_features[] = {" % ip)
+        for name, (readable, writeable) in features:
+            lines.append('\t{ "%s", %s, %s },' % (name, readable, writeable))
+        lines.append("};")
+        lines.append("")
+        entries.append('\t{ "%s", generated_%s_features, %d },' % (ip, ip, len(features)))
+
+    lines.append("static const generated_capabilities generated_ip_capabilities[] = {")
+    lines += entries
+    lines.append("};")
+
+    return "\n".join(lines) + "\n"
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Generate capabilities_generated.h from capabilities files.")
+    parser.add_argument("-o", "--output", required=True, help="Header to write.")
+    parser.add_argument("xml", nargs="+", help="Capabilities files, named <ip>.xml.")
+    args = parser.parse_args()
+
+    files = []
+    for path in args.xml:
+        ip = os.path.splitext(os.path.basename(path))[0]
+        if ip not in IPS:
+            parser.error("%s: unknown IP '%s', expected one of %s" % (path, ip, ", ".join(IPS)))
+        files.append((ip, path))
+
+    try:
+        header = generate(files)
+    except (ET.ParseError, ValueError) as e:
+        print("error: %s" % e, file=sys.stderr)
+        return 1
+
+    with open(args.output, "w") as output:
+        output.write(header)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -16,8 +16,62 @@
 
 #include "xml_configuration.h"
 
+#include <string.h>
+
+#include "helper_functions.h"
+#include "log.h"
+
+#if defined(GRALLOC_GENERATED_CAPABILITIES)
+/* Generated from the capabilities files by gen_capabilities_header.py. */
+#include "capabilities_generated.h"
+#else
+#include "capabilities_type.h"
+#endif
+
 static const std::string xml_base_path = "/vendor/etc/gralloc/";
 
+/*
+ * Helper accumulating the features of a capabilities file into masks.
+ * As with the lookup it replaces, the first entry for a feature wins.
+ */
+class feature_compiler
+{
+public:
+	void add(std::string_view name, bool readable, bool writeable)
+	{
+		const auto feature = find_capability_feature(name);
+		if (!feature.has_value() || (m_listed & capability_bit(*feature)))
+		{
+			return;
+		}
+
+		m_listed |= capability_bit(*feature);
+		if (readable)
+		{
+			m_read |= capability_bit(*feature);
+		}
+		if (writeable)
+		{
+			m_write |= capability_bit(*feature);
+		}
+	}
+
+	capability_mask read() const
+	{
+		return m_read;
+	}
+
+	capability_mask write() const
+	{
+		return m_write;
+	}
+
+private:
+	capability_mask m_listed{0};
+	capability_mask m_read{0};
+	capability_mask m_write{0};
+};
+
 ip_capability::ip_capability(mali_gralloc_ip ip, const char *base_name)
     : ip_capability(ip, base_name, xml_base_path)
 {
@@ -26,55 +80,78 @@ ip_capability::ip_capability(mali_gralloc_ip ip, const char *base_name)
 ip_capability::ip_capability(mali_gralloc_ip ip, const char *base_name, std::string_view base_path)
     : m_ip(ip)
     , m_path(std::string(base_path) + base_name + ".xml")
-    , m_caps(capabilities_type::readCapabilities(m_path.c_str()))
 {
-	if (!m_caps.has_value())
+	feature_compiler features;
+
+#if defined(GRALLOC_GENERATED_CAPABILITIES)
+	GRALLOC_UNUSED(base_path);
+	for (const auto &caps : generated_ip_capabilities)
+	{
+		if (strcmp(caps.ip, base_name) == 0)
+		{
+			for (size_t i = 0; i < caps.feature_count; i++)
+			{
+				features.add(caps.features[i].name, caps.features[i].readable, caps.features[i].writeable);
+			}
+			m_has_caps = true;
+			break;
+		}
+	}
+
+	if (!m_has_caps)
+	{
+		MALI_GRALLOC_LOGV("No generated capabilities for %s", base_name);
+		return;
+	}
+	MALI_GRALLOC_LOGV("Using generated caps for %s", base_name);
+#else
+	const auto caps = capabilities_type::readCapabilities(m_path.c_str());
+	if (!caps.has_value())
 	{
 		MALI_GRALLOC_LOGE("Failed to read capabilities from %s", m_path.c_str());
+		return;
 	}
-	else
+
+	for (const auto &feature : caps->getFeature())
 	{
-		MALI_GRALLOC_LOGV("Read caps from %s", m_path.c_str());
+		bool readable = false;
+		bool writeable = false;
+		switch (feature.getPermission())
+		{
+		case capabilities_type::Permission::RW:
+			readable = true;
+			writeable = true;
+			break;
+		case capabilities_type::Permission::RO:
+			readable = true;
+			break;
+		case capabilities_type::Permission::WO:
+			writeable = true;
+			break;
+		case capabilities_type::Permission::NO:
+			break;
+		default:
+			MALI_GRALLOC_LOGE("Invalid capabilities from %s", m_path.c_str());
+		}
+		features.add(feature.getName(), readable, writeable);
 	}
+
+	m_has_caps = true;
+	MALI_GRALLOC_LOGV("Read caps from %s", m_path.c_str());
+#endif
+
+	m_read_features = features.read();
+	m_write_features = features.write();
 }
 
 bool ip_capability::is_feature_supported(const std::string &feature_name, permission_t permission)
 {
-	for (auto &feature : m_caps->getFeature())
+	/* Features Gralloc does not know of are never supported. */
+	const auto feature = find_capability_feature(feature_name);
+	if (!feature.has_value())
 	{
-		if (feature.getName() == feature_name)
-		{
-			auto &xml_permission = feature.getPermission();
-			bool readable = false;
-			bool writeable = false;
-			switch (xml_permission)
-			{
-			case capabilities_type::Permission::RW:
-				readable = true;
-				writeable = true;
-				break;
-			case capabilities_type::Permission::RO:
-				readable = true;
-				break;
-			case capabilities_type::Permission::WO:
-				writeable = true;
-				break;
-			case capabilities_type::Permission::NO:
-				break;
-			default:
-				MALI_GRALLOC_LOGE("Invalid capabilities from %s", m_path.c_str());
-			}
-			switch (permission)
-			{
-			case permission_t::read:
-				MALI_GRALLOC_LOGV("%s: getReadable(): %d.", feature_name.c_str(), readable);
-				return readable;
-			case permission_t::write:
-				MALI_GRALLOC_LOGV("%s: getWritable(): %d.", feature_name.c_str(), writeable);
-				return writeable;
-			}
-		}
+		return false;
 	}
 
-	return false;
+	return is_feature_supported(*feature, permission);
 }
@@ -19,10 +19,13 @@
 #include <string_view>
 
 #include "gralloc/formats.h"
-#include "capabilities_type.h"
+#include "capability_features.h"
 
 /*
  * @brief class for handling access to a capabilities xml file.
+ *
+ * The features of the file are compiled into read and write masks on construction, so the
+ * file is only parsed once and feature queries are a bit test.
  */
 class ip_capability
 {
@@ -47,6 +50,19 @@ public:
 	 */
 	bool is_feature_supported(const std::string &feature, permission_t permission);
 
+	bool is_feature_supported(capability_feature feature, permission_t permission)
+	{
+		return (get_features(permission) & capability_bit(feature)) != 0;
+	}
+
+	/*
+	 * @brief Get the features supported by the ip with the given permission.
+	 */
+	capability_mask get_features(permission_t permission)
+	{
+		return permission == permission_t::read ? m_read_features : m_write_features;
+	}
+
 	mali_gralloc_ip get_ip()
 	{
 		return m_ip;
@@ -59,11 +75,13 @@ public:
 
 	bool caps_have_value()
 	{
-		return m_caps.has_value();
+		return m_has_caps;
 	}
 
 private:
 	mali_gralloc_ip m_ip;
 	std::string m_path;
-	std::optional<capabilities_type::Capabilities> m_caps;
+	bool m_has_caps{false};
+	capability_mask m_read_features{0};
+	capability_mask m_write_features{0};
 };
@@ -15,10 +15,18 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include <algorithm>
+#include <array>
 #include <errno.h>
 #include <inttypes.h>
 #include <inttypes.h>
+#include <list>
 #include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <sys/mman.h>
+#include <sys/stat.h>
 /* For error codes. */
 #include <hardware/gralloc1.h>
 
@@ -30,6 +38,7 @@
 #include "allocator/allocator.h"
 #include "helper_functions.h"
 #include "format_info.h"
+#include "runtime_config.h"
 
 enum tx_direction
 {
@@ -39,8 +48,207 @@ enum tx_direction
 	TX_BOTH,
 };
 
-/* Mutex used to ensure the buffer map/unmap actions are synchronized */
-static std::mutex g_map_mutex;
+/*
+ * Waits for any change of the lock state in progress in another thread, then sets
+ * LOCK_STATE_BUSY so that this thread alone maps, unmaps, locks or unlocks the buffer.
+ *
+ * @return The lock state before LOCK_STATE_BUSY was set.
+ */
+static int begin_state_change(private_handle_t *hnd)
+{
+	int state = hnd->lock_state.load(std::memory_order_acquire);
+	for (;;)
+	{
+		if (state & private_handle_t::LOCK_STATE_BUSY)
+		{
+			std::this_thread::yield();
+			state = hnd->lock_state.load(std::memory_order_acquire);
+		}
+		else if (hnd->lock_state.compare_exchange_weak(state, state | private_handle_t::LOCK_STATE_BUSY,
+		                                               std::memory_order_acquire, std::memory_order_acquire))
+		{
+			return state;
+		}
+	}
+}
+
+/*
+ * Process-wide cache of the CPU mappings of released buffers.
+ *
+ * Clients which import, lock, unlock and free the same backing store every frame would
+ * otherwise pay for mmap/munmap and the page faults that follow on every frame. When an
+ * imported buffer is released, its mapping is parked here, keyed by backing_store_id, and
+ * handed over to the next handle of the same backing store mapped in this process.
+ *
+ * A parked mapping keeps the backing store alive, so the cache is bounded by a budget of
+ * mapped bytes (vendor.gralloc.mapping_cache_budget_kb) and evicts the least recently
+ * parked mappings first. The budget defaults to 0, which disables the cache: the memory it
+ * pins is charged to the client, so it has to be asked for. The inode of the buffer file is compared as well, so that a
+ * backing_store_id reused by a restarted allocator never returns a stale mapping.
+ */
+class mapping_cache
+{
+public:
+	/*
+	 * Sets hnd->base to a parked mapping of its backing store.
+	 *
+	 * @return true on a hit; false when there is none, in which case the caller maps the buffer.
+	 */
+	bool take(private_handle_t *hnd)
+	{
+		if (get_runtime_config().mapping_cache_budget_bytes() == 0)
+		{
+			return false;
+		}
+
+		struct stat st;
+		const bool has_inode = fstat(hnd->share_fd, &st) == 0;
+
+		std::lock_guard<std::mutex> lock(m_lock);
+
+		auto it = m_index.find(hnd->backing_store_id);
+		if (it == m_index.end() || !has_inode || it->second->inode != st.st_ino ||
+		    it->second->size != static_cast<uint64_t>(hnd->size))
+		{
+			m_misses++;
+			return false;
+		}
+
+		hnd->base = it->second->base;
+		m_resident_bytes -= it->second->size;
+		m_entries.erase(it->second);
+		m_index.erase(it);
+		m_hits++;
+		return true;
+	}
+
+	/*
+	 * Parks the mapping of hnd, leaving hnd unmapped.
+	 *
+	 * @return true when the mapping was parked; false when it cannot be cached, in which case
+	 *         the caller unmaps the buffer.
+	 */
+	bool put(private_handle_t *hnd)
+	{
+		const uint64_t budget = get_runtime_config().mapping_cache_budget_bytes();
+		const uint64_t size = static_cast<uint64_t>(hnd->size);
+		struct stat st;
+		if (size > budget || fstat(hnd->share_fd, &st) != 0)
+		{
+			/* The budget may have been lowered since the mappings were parked. */
+			std::vector<entry> evicted;
+			{
+				std::lock_guard<std::mutex> lock(m_lock);
+				trim(budget, evicted);
+			}
+			unmap(evicted);
+			return false;
+		}
+
+		std::vector<entry> evicted;
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+
+			/* Another handle of the same backing store was released first; keep the newer mapping. */
+			auto it = m_index.find(hnd->backing_store_id);
+			if (it != m_index.end())
+			{
+				m_resident_bytes -= it->second->size;
+				evicted.push_back(*it->second);
+				m_entries.erase(it->second);
+				m_index.erase(it);
+			}
+
+			m_entries.push_front({ hnd->backing_store_id, st.st_ino, hnd->base, size });
+			m_index.emplace(hnd->backing_store_id, m_entries.begin());
+			m_resident_bytes += size;
+
+			trim(budget, evicted);
+		}
+
+		unmap(evicted);
+		hnd->base = nullptr;
+		return true;
+	}
+
+	/* Unmaps the parked mapping of a backing store, if any. */
+	void evict(uint64_t backing_store_id)
+	{
+		std::vector<entry> evicted;
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+
+			auto it = m_index.find(backing_store_id);
+			if (it == m_index.end())
+			{
+				return;
+			}
+
+			m_resident_bytes -= it->second->size;
+			evicted.push_back(*it->second);
+			m_entries.erase(it->second);
+			m_index.erase(it);
+		}
+
+		unmap(evicted);
+	}
+
+	mapping_cache_stats stats()
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		return { m_hits, m_misses, m_resident_bytes, m_entries.size() };
+	}
+
+private:
+	struct entry
+	{
+		uint64_t backing_store_id;
+		ino_t inode;
+		void *base;
+		uint64_t size;
+	};
+
+	using entry_list = std::list<entry>;
+
+	/* Moves the least recently parked mappings out of the cache until it fits in budget. */
+	void trim(uint64_t budget, std::vector<entry> &evicted)
+	{
+		while (m_resident_bytes > budget)
+		{
+			const entry &oldest = m_entries.back();
+			m_resident_bytes -= oldest.size;
+			m_index.erase(oldest.backing_store_id);
+			evicted.push_back(oldest);
+			m_entries.pop_back();
+		}
+	}
+
+	/*
+	 * Unmaps evicted mappings, outside of the cache lock. Every allocator maps the whole
+	 * buffer with a single mmap(), so this matches what allocator_unmap() would do.
+	 */
+	static void unmap(const std::vector<entry> &evicted)
+	{
+		for (const auto &e : evicted)
+		{
+			if (munmap(e.base, e.size) < 0)
+			{
+				MALI_GRALLOC_LOGE("Could not munmap cached mapping base:%p size:%" PRIu64 " '%s'",
+				                  e.base, e.size, strerror(errno));
+			}
+		}
+	}
+
+	std::mutex m_lock;
+	/* Most recently parked first. */
+	entry_list m_entries;
+	std::unordered_map<uint64_t, entry_list::iterator> m_index;
+	uint64_t m_resident_bytes{0};
+	uint64_t m_hits{0};
+	uint64_t m_misses{0};
+};
+
+static mapping_cache s_mapping_cache;
 
 private_handle_t *make_private_handle(int flags, int size, uint64_t consumer_usage, uint64_t producer_usage,
                                       android::base::unique_fd shared_fd, int required_format,
@@ -87,37 +295,308 @@ static enum tx_direction get_tx_direction(const uint64_t usage)
 	return dir;
 }
 
-static void buffer_sync(private_handle_t *hnd, tx_direction direction)
+/*
+ * Byte range of the buffer touched by CPU access to the locked region.
+ */
+struct sync_range
+{
+	uint64_t offset;
+	uint64_t size;
+};
+
+/*
+ * Access region of a CPU lock, in pixels: [left, right) x [top, bottom).
+ */
+struct lock_region
+{
+	int left;
+	int top;
+	int right;
+	int bottom;
+
+	bool contains(const lock_region &other) const
+	{
+		return left <= other.left && top <= other.top && right >= other.right && bottom >= other.bottom;
+	}
+};
+
+/*
+ * Returns the access region [l, l + w) x [t, t + h). An empty access region stands for the
+ * whole buffer.
+ */
+static lock_region make_lock_region(const private_handle_t *hnd, const int l, const int t, const int w, const int h)
+{
+	if (w == 0 || h == 0)
+	{
+		return { 0, 0, hnd->width, hnd->height };
+	}
+
+	return { l, t, l + w, t + h };
+}
+
+static lock_region get_lock_region(const private_handle_t *hnd)
 {
-	if (direction != TX_NONE)
+	return { hnd->lock_left, hnd->lock_top, hnd->lock_right, hnd->lock_bottom };
+}
+
+static void set_lock_region(private_handle_t *hnd, const lock_region &region)
+{
+	hnd->lock_left = region.left;
+	hnd->lock_top = region.top;
+	hnd->lock_right = region.right;
+	hnd->lock_bottom = region.bottom;
+}
+
+/*
+ * Computes the byte range of each plane covered by an access region of the buffer.
+ *
+ * @return The number of ranges in 'ranges', or 0 when the whole buffer has to be synced:
+ *         the region covers the whole buffer, or the layout does not map rows of pixels to
+ *         rows of bytes (compressed, block linear and tiled formats, multi-layer buffers).
+ */
+static size_t get_sync_ranges(const private_handle_t *hnd, const lock_region &region,
+                              std::array<sync_range, max_planes> &ranges)
+{
+	if (region.contains({ 0, 0, hnd->width, hnd->height }))
+	{
+		return 0;
+	}
+
+	const auto alloc_format = hnd->get_alloc_format();
+	const auto *format_info = alloc_format.get_base_info();
+	if (format_info == nullptr || alloc_format.has_modifiers() || format_info->tile_size > 1 ||
+	    hnd->layer_count > 1)
 	{
-		++hnd->lock_count;
-		hnd->cpu_write = direction == TX_TO_DEVICE || direction == TX_BOTH;
-		int cpu_read = direction == TX_FROM_DEVICE || direction == TX_BOTH;
+		return 0;
+	}
 
-		int status = allocator_sync_start(hnd, cpu_read, hnd->cpu_write);
+	/*
+	 * Packed YUV formats store whole sub-sampled groups of pixels. Formats which are not
+	 * sub-sampled have an hsub of 0.
+	 */
+	const uint64_t group = std::max<uint64_t>(format_info->hsub, 1);
+	const uint64_t left = region.left & ~(group - 1);
+	const uint64_t right = GRALLOC_ALIGN(region.right, group);
+
+	size_t n_ranges = 0;
+	for (size_t plane = 0; plane < format_info->npln; plane++)
+	{
+		const plane_info_t &info = hnd->plane_info[plane];
+		const uint64_t hsub = plane == 0 ? 1 : format_info->hsub;
+		const uint64_t vsub = plane == 0 ? 1 : format_info->vsub;
+
+		const uint64_t first_row = region.top / vsub;
+		const uint64_t last_row = (region.bottom + vsub - 1) / vsub - 1;
+		/* Round outwards to whole bytes, for formats of less than 8 bits per pixel. */
+		const uint64_t begin = info.offset + first_row * info.byte_stride + (left / hsub) * format_info->bpp[plane] / 8;
+		const uint64_t end = info.offset + last_row * info.byte_stride +
+		                     (((right + hsub - 1) / hsub) * format_info->bpp[plane] + 7) / 8;
+
+		if (end <= begin || end > static_cast<uint64_t>(hnd->size))
+		{
+			return 0;
+		}
+
+		ranges[n_ranges++] = { begin, end - begin };
+	}
+
+	return n_ranges;
+}
+
+/*
+ * Starts or ends CPU access to a region of the buffer, syncing only the bytes the region
+ * covers where the layout allows.
+ */
+static int sync_region(const private_handle_t *hnd, const lock_region &region, const bool start,
+                       const bool read, const bool write)
+{
+	std::array<sync_range, max_planes> ranges;
+	const size_t n_ranges = get_sync_ranges(hnd, region, ranges);
+	if (n_ranges == 0)
+	{
+		return start ? allocator_sync_start(hnd, read, write) : allocator_sync_end(hnd, read, write);
+	}
+
+	for (size_t i = 0; i < n_ranges; i++)
+	{
+		const int status = start ? allocator_sync_range_start(hnd, read, write, ranges[i].offset, ranges[i].size)
+		                         : allocator_sync_range_end(hnd, read, write, ranges[i].offset, ranges[i].size);
 		if (status < 0)
 		{
-			return;
+			return status;
 		}
 	}
+
+	return 0;
+}
+
+/* From the kernel mman uapi, Linux 5.14 onwards. */
+#if !defined(MADV_POPULATE_READ)
+#define MADV_POPULATE_READ 22
+#define MADV_POPULATE_WRITE 23
+#endif
+
+/*
+ * Populates the page tables for the bytes an access region covers, so that the first CPU
+ * accesses after the lock do not fault page by page. Only done for buffers allocated with
+ * RK_GRALLOC_USAGE_PREFAULT_MAPPING, or for all buffers with vendor.gralloc.prefault_mappings.
+ *
+ * MADV_POPULATE_* fails on kernels before 5.14 and on the VM_PFNMAP mappings of dma-buf heaps.
+ * The pages are then touched with a read each, which works on any mapping: a read fault maps
+ * shared pages writable, so it also covers write locks. Heaps mapping the whole buffer with
+ * remap_pfn_range() at mmap() time have nothing left to fault in.
+ */
+static void prefault_region(const private_handle_t *hnd, const lock_region &region, const bool write)
+{
+	if (!((hnd->producer_usage | hnd->consumer_usage) & RK_GRALLOC_USAGE_PREFAULT_MAPPING) &&
+	    !get_runtime_config().prefault_mappings())
+	{
+		return;
+	}
+
+	std::array<sync_range, max_planes> ranges;
+	size_t n_ranges = get_sync_ranges(hnd, region, ranges);
+	if (n_ranges == 0)
+	{
+		ranges[0] = { 0, static_cast<uint64_t>(hnd->size) };
+		n_ranges = 1;
+	}
+
+	const uint64_t page_size = getpagesize();
+	for (size_t i = 0; i < n_ranges; i++)
+	{
+		const uint64_t begin = ranges[i].offset & ~(page_size - 1);
+		const uint64_t end = GRALLOC_ALIGN(ranges[i].offset + ranges[i].size, page_size);
+		std::byte *addr = static_cast<std::byte *>(hnd->base) + begin;
+		if (madvise(addr, end - begin, write ? MADV_POPULATE_WRITE : MADV_POPULATE_READ) == 0)
+		{
+			continue;
+		}
+
+		const volatile std::byte *page = addr;
+		for (uint64_t offset = 0; offset < end - begin; offset += page_size)
+		{
+			const std::byte value = page[offset];
+			(void)value;
+		}
+	}
+}
+
+/*
+ * Takes a CPU lock of the buffer and starts CPU access to the access region.
+ *
+ * The outstanding locks, of any kind, are counted in the LOCK_STATE_READ_MASK bits of the lock
+ * state; LOCK_STATE_WRITE is set while any of them is for write. As before, locks may overlap:
+ * a read lock of a buffer locked for write, or a write lock of a locked buffer, is granted, and
+ * the content each lock observes is then indeterminate. Two write locks are rejected by the
+ * mapper, except for BLOB buffers.
+ *
+ * Caches are synced on the first lock, and again on locks accessing bytes outside of the region
+ * already synced or writing to a buffer only locked for read so far. The matching SYNC_END is
+ * issued once, on the last unlock.
+ *
+ * @return 0, on success;
+ *         -EBUSY, when the lock count would overflow.
+ */
+static int buffer_lock_sync(private_handle_t *hnd, const tx_direction direction,
+                            const int l, const int t, const int w, const int h)
+{
+	if (direction == TX_NONE)
+	{
+		return 0;
+	}
+
+	const bool read = direction == TX_FROM_DEVICE || direction == TX_BOTH;
+	const bool write = direction == TX_TO_DEVICE || direction == TX_BOTH;
+	const lock_region region = make_lock_region(hnd, l, t, w, h);
+
+	const int state = begin_state_change(hnd);
+	const int locks = state & private_handle_t::LOCK_STATE_READ_MASK;
+
+	if (locks == private_handle_t::LOCK_STATE_READ_MASK)
+	{
+		MALI_GRALLOC_LOGE("Too many CPU locks of buffer %p", hnd);
+
+		/* Also clears LOCK_STATE_BUSY. */
+		hnd->lock_state.store(state, std::memory_order_release);
+		return -EBUSY;
+	}
+
+	/*
+	 * A failed sync is only logged by the allocator and leaves the buffer locked, as the
+	 * client still unlocks it.
+	 */
+	if (locks == 0)
+	{
+		set_lock_region(hnd, region);
+		sync_region(hnd, region, true, read, write);
+	}
 	else
 	{
-		if (hnd->cpu_write)
+		const lock_region synced = get_lock_region(hnd);
+		if (!synced.contains(region) || (write && !(state & private_handle_t::LOCK_STATE_WRITE)))
 		{
-			/* Flush the cache only when there is a cpu_write lock. */
-			int status = allocator_sync_end(hnd, false, hnd->cpu_write);
-			if (status < 0)
-			{
-				return;
-			}
+			set_lock_region(hnd, { std::min(synced.left, region.left), std::min(synced.top, region.top),
+			                       std::max(synced.right, region.right), std::max(synced.bottom, region.bottom) });
+			sync_region(hnd, region, true, read, write);
 		}
-		hnd->lock_count > 0 ? --hnd->lock_count : hnd->lock_count = 0;
-		if (hnd->lock_count == 0)
+	}
+
+	int new_state = state + 1;
+	if (write)
+	{
+		if (locks != 0)
+		{
+			MALI_GRALLOC_LOGV("Buffer %p locked for write while already locked", hnd);
+		}
+		hnd->cpu_write = hnd->cpu_write == TX_BOTH ? TX_BOTH : direction;
+		new_state |= private_handle_t::LOCK_STATE_WRITE;
+	}
+
+	/* Also clears LOCK_STATE_BUSY. */
+	hnd->lock_state.store(new_state, std::memory_order_release);
+
+	++hnd->lock_count;
+	prefault_region(hnd, region, write);
+	return 0;
+}
+
+/*
+ * Releases a CPU lock of the buffer. The last unlock ends CPU access to the region synced by
+ * the locks.
+ *
+ * @return 0, on success;
+ *         -EINVAL, when the buffer is not locked.
+ */
+static int buffer_unlock_sync(private_handle_t *hnd)
+{
+	const int state = begin_state_change(hnd);
+	const int locks = state & private_handle_t::LOCK_STATE_READ_MASK;
+	int new_state = state;
+
+	if (locks == 0)
+	{
+		MALI_GRALLOC_LOGW("Unlocking buffer %p which is not locked", hnd);
+	}
+	else
+	{
+		new_state--;
+		--hnd->lock_count;
+
+		if (locks == 1)
 		{
+			sync_region(hnd, get_lock_region(hnd), false, hnd->cpu_write != TX_TO_DEVICE,
+			            (state & private_handle_t::LOCK_STATE_WRITE) != 0);
 			hnd->cpu_write = 0;
+			new_state &= ~private_handle_t::LOCK_STATE_WRITE;
+			set_lock_region(hnd, { 0, 0, 0, 0 });
 		}
 	}
+
+	/* Also clears LOCK_STATE_BUSY. */
+	hnd->lock_state.store(new_state, std::memory_order_release);
+
+	return new_state != state ? 0 : -EINVAL;
 }
 
 /*
@@ -275,7 +754,11 @@ int mali_gralloc_lock(buffer_handle_t buffer,
 		}
 
 		*vaddr = hnd->base;
-		buffer_sync(hnd, get_tx_direction(usage));
+		status = buffer_lock_sync(hnd, get_tx_direction(usage), l, t, w, h);
+		if (status != 0)
+		{
+			return status;
+		}
 	}
 
 	return 0;
@@ -326,6 +809,7 @@ int mali_gralloc_lock_ycbcr(const buffer_handle_t buffer,
 		return status;
 	}
 
+
 	const auto alloc_format = hnd->get_alloc_format();
 	const auto *format_info = alloc_format.get_base_info();
 	if (format_info == nullptr)
@@ -403,7 +887,11 @@ int mali_gralloc_lock_ycbcr(const buffer_handle_t buffer,
 			return -EINVAL;
 		}
 
-		buffer_sync(hnd, get_tx_direction(usage));
+		status = buffer_lock_sync(hnd, get_tx_direction(usage), l, t, w, h);
+		if (status != 0)
+		{
+			return status;
+		}
 	}
 	else
 	{
@@ -444,7 +932,7 @@ int mali_gralloc_unlock(buffer_handle_t buffer)
 	}
 
 	private_handle_t *hnd = (private_handle_t *)buffer;
-	buffer_sync(hnd, TX_NONE);
+	buffer_unlock_sync(hnd);
 
 	return 0;
 }
@@ -560,6 +1048,7 @@ int mali_gralloc_lock_flex(const buffer_handle_t buffer, const uint64_t usage, c
 		return status;
 	}
 
+
 	const auto alloc_format = hnd->get_alloc_format();
 	const auto *format_info = alloc_format.get_base_info();
 	if (format_info == nullptr)
@@ -843,7 +1332,11 @@ int mali_gralloc_lock_flex(const buffer_handle_t buffer, const uint64_t usage, c
 		return GRALLOC1_ERROR_UNSUPPORTED;
 	}
 
-	buffer_sync(hnd, get_tx_direction(usage));
+	status = buffer_lock_sync(hnd, get_tx_direction(usage), l, t, w, h);
+	if (status != 0)
+	{
+		return status;
+	}
 
 	return GRALLOC1_ERROR_NONE;
 }
@@ -862,33 +1355,54 @@ int mali_gralloc_lock_flex(const buffer_handle_t buffer, const uint64_t usage, c
  */
 int mali_map_buffer(private_handle_t *hnd)
 {
-	int status = 0;
+	/* Fast path: every lock but the first of a buffer finds it mapped. */
+	if (hnd->lock_state.load(std::memory_order_acquire) & private_handle_t::LOCK_STATE_MAPPED)
+	{
+		return 0;
+	}
 
 	/* Ensure that buffer is only mapped once as there can
 	   be multiple lock() requests issued for the same buffer */
-	std::scoped_lock lock(g_map_mutex);
-	if (!hnd->base)
+	if (begin_state_change(hnd) & private_handle_t::LOCK_STATE_MAPPED)
+	{
+		hnd->lock_state.fetch_and(~private_handle_t::LOCK_STATE_BUSY, std::memory_order_release);
+		return 0;
+	}
+
+	/* The allocating process may have kept the mapping made at allocation time. */
+	int status = 0;
+	if (!hnd->base && !s_mapping_cache.take(hnd))
 	{
 		status = allocator_map(hnd);
 	}
+
+	if (status == 0)
+	{
+		/* Clears LOCK_STATE_BUSY and sets LOCK_STATE_MAPPED. */
+		hnd->lock_state.fetch_xor(private_handle_t::LOCK_STATE_BUSY | private_handle_t::LOCK_STATE_MAPPED,
+		                          std::memory_order_release);
+	}
+	else
+	{
+		hnd->lock_state.fetch_and(~private_handle_t::LOCK_STATE_BUSY, std::memory_order_release);
+	}
+
 	return status;
 }
 
 /*
- * Unmaps the buffer to no longer make it CPU accessible
- *
- * @param hnd [in]  The buffer to map
- *
- * Note: The function can be safely called on buffers that
- * are not currently mapped as it will check whether the buffer
- * was previously mapped.
+ * Unmaps the buffer, or parks its mapping in the mapping cache when 'cache' is set.
  */
-void mali_unmap_buffer(private_handle_t *hnd)
+static void unmap_buffer(private_handle_t *hnd, const bool cache)
 {
-	std::scoped_lock lock(g_map_mutex);
+	begin_state_change(hnd);
+
 	if (hnd->base)
 	{
-		allocator_unmap(hnd);
+		if (!cache || !s_mapping_cache.put(hnd))
+		{
+			allocator_unmap(hnd);
+		}
 
 		/* We expect the allocators implementation to clear hnd->base & cpu flags
 		 * but since implementations can change, it is also reset here */
@@ -896,4 +1410,39 @@ void mali_unmap_buffer(private_handle_t *hnd)
 		hnd->cpu_write = 0;
 		hnd->lock_count = 0;
 	}
+
+	/* Any lock left is dropped with the mapping. Also clears LOCK_STATE_BUSY. */
+	set_lock_region(hnd, { 0, 0, 0, 0 });
+	hnd->lock_state.store(0, std::memory_order_release);
+}
+
+/*
+ * Unmaps the buffer to no longer make it CPU accessible
+ *
+ * @param hnd [in]  The buffer to map
+ *
+ * Note: The function can be safely called on buffers that
+ * are not currently mapped as it will check whether the buffer
+ * was previously mapped.
+ */
+void mali_unmap_buffer(private_handle_t *hnd)
+{
+	s_mapping_cache.evict(hnd->backing_store_id);
+	unmap_buffer(hnd, false);
+}
+
+/*
+ * Releases the CPU mapping of a buffer which is no longer referenced by this process,
+ * keeping it in the mapping cache for the next import of the same backing store.
+ *
+ * @param hnd [in]  The buffer to release the mapping of
+ */
+void mali_release_buffer_mapping(private_handle_t *hnd)
+{
+	unmap_buffer(hnd, true);
+}
+
+mapping_cache_stats mali_gralloc_get_mapping_cache_stats()
+{
+	return s_mapping_cache.stats();
 }
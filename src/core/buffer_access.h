@@ -34,3 +34,14 @@ int mali_gralloc_lock_flex(buffer_handle_t buffer, uint64_t usage, int l, int t,
 
 int mali_map_buffer(private_handle_t *hnd);
 void mali_unmap_buffer(private_handle_t *hnd);
+void mali_release_buffer_mapping(private_handle_t *hnd);
+
+struct mapping_cache_stats
+{
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t resident_bytes;
+	size_t entries;
+};
+
+mapping_cache_stats mali_gralloc_get_mapping_cache_stats();
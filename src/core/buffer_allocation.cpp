@@ -23,6 +23,15 @@
 #include <assert.h>
 #include <atomic>
 #include <algorithm>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #include <hardware/hardware.h>
 #include <hardware/gralloc1.h>
@@ -38,10 +47,14 @@
 #include "format_selection.h"
 #include "usages.h"
 #include "helper_functions.h"
+#include "runtime_config.h"
 
 #define AFBC_PIXELS_PER_BLOCK 256
 #define AFBC_HEADER_BUFFER_BYTES_PER_BLOCKENTRY 16
 
+/* Upper bound of the number of entries in the derived layout cache. */
+#define DERIVED_LAYOUT_CACHE_MAX_ENTRIES 128
+
 
 /*
  * Get a global unique ID
@@ -338,6 +351,58 @@ std::optional<alloc_type_t> get_alloc_type(const internal_format_t format, const
 
 bool is_subsampled_yuv(const internal_format_t format);
 
+/*
+ * Size in bytes of the AFBC header written by init_afbc(), excluding the alignment
+ * padding before the body. Width and height should already be AFBC aligned.
+ */
+uint32_t afbc_header_size(const int w, const int h)
+{
+	const uint32_t n_headers = (w * h) / AFBC_PIXELS_PER_BLOCK;
+	return n_headers * AFBC_HEADER_BUFFER_BYTES_PER_BLOCKENTRY;
+}
+
+/*
+ * Fills n_headers consecutive AFBC header entries with the same 16 byte value.
+ *
+ * An all-zero entry (tiled headers of non-subsampled formats) is a plain memset. Otherwise the
+ * entry is kept in a vector register and written with wide stores, four entries per iteration.
+ */
+static void fill_afbc_headers(uint8_t *buf, const uint32_t header[4], const uint32_t n_headers)
+{
+	if ((header[0] | header[1] | header[2] | header[3]) == 0)
+	{
+		memset(buf, 0, static_cast<size_t>(n_headers) * AFBC_HEADER_BUFFER_BYTES_PER_BLOCKENTRY);
+		return;
+	}
+
+	uint32_t i = 0;
+#if defined(__ARM_NEON)
+	const uint32x4_t entry = vld1q_u32(header);
+	uint32_t *dst = reinterpret_cast<uint32_t *>(buf);
+	for (; i + 4 <= n_headers; i += 4, dst += 16)
+	{
+		vst1q_u32(dst, entry);
+		vst1q_u32(dst + 4, entry);
+		vst1q_u32(dst + 8, entry);
+		vst1q_u32(dst + 12, entry);
+	}
+#elif defined(__SSE2__)
+	const __m128i entry = _mm_loadu_si128(reinterpret_cast<const __m128i *>(header));
+	__m128i *dst = reinterpret_cast<__m128i *>(buf);
+	for (; i + 4 <= n_headers; i += 4, dst += 4)
+	{
+		_mm_storeu_si128(dst, entry);
+		_mm_storeu_si128(dst + 1, entry);
+		_mm_storeu_si128(dst + 2, entry);
+		_mm_storeu_si128(dst + 3, entry);
+	}
+#endif
+	for (; i < n_headers; i++)
+	{
+		memcpy(buf + i * AFBC_HEADER_BUFFER_BYTES_PER_BLOCKENTRY, header, AFBC_HEADER_BUFFER_BYTES_PER_BLOCKENTRY);
+	}
+}
+
 /*
  * Initialise AFBC header based on superblock layout.
  * Width and height should already be AFBC aligned.
@@ -348,7 +413,7 @@ void init_afbc(uint8_t *buf, const internal_format_t alloc_format,
 {
 	const bool is_tiled = alloc_format.get_afbc_tiled_headers();
 	const uint32_t n_headers = (w * h) / AFBC_PIXELS_PER_BLOCK;
-	int body_offset = n_headers * AFBC_HEADER_BUFFER_BYTES_PER_BLOCKENTRY;
+	int body_offset = afbc_header_size(w, h);
 
 	afbc_buffer_align(is_tiled, &body_offset);
 
@@ -385,11 +450,8 @@ void init_afbc(uint8_t *buf, const internal_format_t alloc_format,
 
 	MALI_GRALLOC_LOGV("Writing AFBC header layout %d for format %" PRIx32, layout, base_format);
 
-	for (uint32_t i = 0; i < n_headers; i++)
-	{
-		memcpy(buf, headers[layout], sizeof(headers[layout]));
-		buf += sizeof(headers[layout]);
-	}
+	static_assert(sizeof(headers[0]) == AFBC_HEADER_BUFFER_BYTES_PER_BLOCKENTRY);
+	fill_afbc_headers(buf, headers[layout], n_headers);
 }
 
 static int max(int a, int b)
@@ -998,7 +1060,7 @@ static bool validate_format(const format_info_t * const format,
 
 /*---------------------------------------------------------------------------*/
 
-int mali_gralloc_derive_format_and_size(buffer_descriptor_t *descriptor)
+static int derive_format_and_size(buffer_descriptor_t *descriptor)
 {
 	int err;
 
@@ -1164,6 +1226,159 @@ int mali_gralloc_derive_format_and_size(buffer_descriptor_t *descriptor)
 	return 0;
 }
 
+/*
+ * Bounded LRU cache of the results of derive_format_and_size().
+ *
+ * The derived format and layout only depend on the requested parameters making up the key,
+ * the framebuffer size, the IP capabilities (fixed once loaded) and the runtime configuration.
+ * The framebuffer size is part of the key, as it is only known once the first framebuffer is
+ * allocated, possibly by another process. Entries are tagged with the generation of the runtime
+ * configuration and dropped as soon as it changes.
+ */
+class derived_layout_cache
+{
+public:
+	struct key_t
+	{
+		uint64_t hal_format;
+		uint64_t producer_usage;
+		uint64_t consumer_usage;
+		uint32_t width;
+		uint32_t height;
+		uint32_t layer_count;
+		int fb_size;
+
+		bool operator==(const key_t &other) const
+		{
+			return hal_format == other.hal_format && producer_usage == other.producer_usage &&
+			       consumer_usage == other.consumer_usage && width == other.width &&
+			       height == other.height && layer_count == other.layer_count && fb_size == other.fb_size;
+		}
+	};
+
+	struct value_t
+	{
+		int err;
+		internal_format_t alloc_format;
+		plane_layout plane_info;
+		int pixel_stride;
+		size_t size;
+	};
+
+	bool lookup(const key_t &key, uint32_t generation, value_t *value)
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+
+		if (generation != m_generation)
+		{
+			MALI_GRALLOC_LOGV("Runtime configuration changed, dropping %zu derived layouts (hits: %" PRIu64
+			                  ", misses: %" PRIu64 ")", m_entries.size(), m_hits.load(), m_misses.load());
+			m_index.clear();
+			m_entries.clear();
+			m_generation = generation;
+		}
+
+		auto it = m_index.find(key);
+		if (it == m_index.end())
+		{
+			m_misses++;
+			return false;
+		}
+
+		m_entries.splice(m_entries.begin(), m_entries, it->second);
+		*value = it->second->second;
+		m_hits++;
+		return true;
+	}
+
+	void insert(const key_t &key, uint32_t generation, const value_t &value)
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+
+		/* Derived from a configuration which is no longer current. */
+		if (generation != m_generation || m_index.count(key) != 0)
+		{
+			return;
+		}
+
+		m_entries.emplace_front(key, value);
+		m_index.emplace(key, m_entries.begin());
+
+		if (m_entries.size() > DERIVED_LAYOUT_CACHE_MAX_ENTRIES)
+		{
+			m_index.erase(m_entries.back().first);
+			m_entries.pop_back();
+		}
+	}
+
+	derived_layout_cache_stats stats()
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		return { m_hits.load(), m_misses.load(), m_entries.size() };
+	}
+
+private:
+	struct key_hash
+	{
+		size_t operator()(const key_t &key) const
+		{
+			uint64_t h = key.hal_format;
+			h = h * 31 + key.producer_usage;
+			h = h * 31 + key.consumer_usage;
+			h = h * 31 + ((static_cast<uint64_t>(key.width) << 32) | key.height);
+			h = h * 31 + ((static_cast<uint64_t>(key.layer_count) << 32) | static_cast<uint32_t>(key.fb_size));
+			return std::hash<uint64_t>{}(h);
+		}
+	};
+
+	using entry_list = std::list<std::pair<key_t, value_t>>;
+
+	std::mutex m_lock;
+	/* Most recently used first. */
+	entry_list m_entries;
+	std::unordered_map<key_t, entry_list::iterator, key_hash> m_index;
+	uint32_t m_generation{0};
+	std::atomic<uint64_t> m_hits{0};
+	std::atomic<uint64_t> m_misses{0};
+};
+
+static derived_layout_cache s_derived_layout_cache;
+
+int mali_gralloc_derive_format_and_size(buffer_descriptor_t *descriptor)
+{
+	const derived_layout_cache::key_t key = {
+		descriptor->hal_format, descriptor->producer_usage, descriptor->consumer_usage,
+		descriptor->width, descriptor->height, descriptor->layer_count, get_fb_size(),
+	};
+	const uint32_t generation = get_runtime_config().generation();
+
+	derived_layout_cache::value_t value;
+	if (s_derived_layout_cache.lookup(key, generation, &value))
+	{
+		if (value.err == 0)
+		{
+			descriptor->alloc_format = value.alloc_format;
+			descriptor->plane_info = value.plane_info;
+			descriptor->pixel_stride = value.pixel_stride;
+			descriptor->size = value.size;
+		}
+		return value.err;
+	}
+
+	value.err = derive_format_and_size(descriptor);
+	value.alloc_format = descriptor->alloc_format;
+	value.plane_info = descriptor->plane_info;
+	value.pixel_stride = descriptor->pixel_stride;
+	value.size = descriptor->size;
+	s_derived_layout_cache.insert(key, generation, value);
+
+	return value.err;
+}
+
+derived_layout_cache_stats mali_gralloc_get_derived_layout_cache_stats()
+{
+	return s_derived_layout_cache.stats();
+}
 
 int mali_gralloc_buffer_allocate(buffer_descriptor_t *descriptor, private_handle_t **out_handle)
 {
@@ -1184,6 +1399,35 @@ int mali_gralloc_buffer_allocate(buffer_descriptor_t *descriptor, private_handle
 	return 0;
 }
 
+int mali_gralloc_buffer_allocate_batch(buffer_descriptor_t *descriptor, uint32_t count,
+                                       private_handle_t **out_handles)
+{
+	int err = mali_gralloc_derive_format_and_size(descriptor);
+	if (err != 0)
+	{
+		return err;
+	}
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		int ret = allocator_allocate(descriptor, &out_handles[i]);
+		if (ret != 0)
+		{
+			while (i-- > 0)
+			{
+				mali_gralloc_buffer_free(out_handles[i]);
+				native_handle_delete(out_handles[i]);
+				out_handles[i] = nullptr;
+			}
+			return ret;
+		}
+
+		out_handles[i]->backing_store_id = getUniqueId();
+	}
+
+	return 0;
+}
+
 int mali_gralloc_buffer_free(private_handle_t *hnd)
 {
 	if (hnd == nullptr)
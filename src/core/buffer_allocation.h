@@ -146,10 +146,30 @@ struct AllocType
 
 using alloc_type_t = AllocType;
 
+/*
+ * Selects the internal format of the buffer and computes its size and plane layout.
+ * Results are cached, keyed on the requested format, usage, dimensions and layer count.
+ */
 int mali_gralloc_derive_format_and_size(buffer_descriptor_t *descriptor);
 
+struct derived_layout_cache_stats
+{
+	uint64_t hits;
+	uint64_t misses;
+	size_t entries;
+};
+
+derived_layout_cache_stats mali_gralloc_get_derived_layout_cache_stats();
+
 int mali_gralloc_buffer_allocate(buffer_descriptor_t *descriptor, private_handle_t **out_handle);
 
+/*
+ * Allocates count buffers of identical properties. The format and size are derived once
+ * for the whole batch. On failure, no buffer is returned and -errno is reported.
+ */
+int mali_gralloc_buffer_allocate_batch(buffer_descriptor_t *descriptor, uint32_t count,
+                                       private_handle_t **out_handles);
+
 int mali_gralloc_buffer_free(private_handle_t *handle);
 
 uint32_t lcm(uint32_t a, uint32_t b);
@@ -0,0 +1,250 @@
+/*
+ * Copyright (C) 2022 Arm Limited. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <string.h>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "buffer_copy.h"
+#include "buffer.h"
+#include "format_info.h"
+#include "internal_format.h"
+#include "log.h"
+
+/* Bytes moved per iteration of the wide copy loops: a write-combining line. */
+#define WIDE_COPY_BYTES 64
+
+/*
+ * Copies a row into write-combined memory. The head of the row, up to the first line boundary
+ * of the destination, and its tail go through memcpy(). The lines in between are written whole,
+ * WIDE_COPY_BYTES at a time with stores aligned on the line.
+ */
+static void copy_row_to_uncached(uint8_t *dst, const uint8_t *src, size_t size)
+{
+	size_t head = (WIDE_COPY_BYTES - (reinterpret_cast<uintptr_t>(dst) & (WIDE_COPY_BYTES - 1))) &
+	              (WIDE_COPY_BYTES - 1);
+	if (head > size)
+	{
+		head = size;
+	}
+	memcpy(dst, src, head);
+	dst += head;
+	src += head;
+	size -= head;
+
+#if defined(__ARM_NEON)
+	for (; size >= WIDE_COPY_BYTES; size -= WIDE_COPY_BYTES, src += WIDE_COPY_BYTES, dst += WIDE_COPY_BYTES)
+	{
+		const uint8x16_t v0 = vld1q_u8(src);
+		const uint8x16_t v1 = vld1q_u8(src + 16);
+		const uint8x16_t v2 = vld1q_u8(src + 32);
+		const uint8x16_t v3 = vld1q_u8(src + 48);
+#if defined(__aarch64__)
+		/* Non-temporal pair stores: the data is not read back by this CPU. */
+		__asm__ volatile("stnp %q[v0], %q[v1], [%[dst]]\n\t"
+		                 "stnp %q[v2], %q[v3], [%[dst], #32]"
+		                 :
+		                 : [v0] "w"(v0), [v1] "w"(v1), [v2] "w"(v2), [v3] "w"(v3), [dst] "r"(dst)
+		                 : "memory");
+#else
+		vst1q_u8(dst, v0);
+		vst1q_u8(dst + 16, v1);
+		vst1q_u8(dst + 32, v2);
+		vst1q_u8(dst + 48, v3);
+#endif
+	}
+#elif defined(__SSE2__)
+	for (; size >= WIDE_COPY_BYTES; size -= WIDE_COPY_BYTES, src += WIDE_COPY_BYTES, dst += WIDE_COPY_BYTES)
+	{
+		const __m128i *s = reinterpret_cast<const __m128i *>(src);
+		__m128i *d = reinterpret_cast<__m128i *>(dst);
+		_mm_stream_si128(d, _mm_loadu_si128(s));
+		_mm_stream_si128(d + 1, _mm_loadu_si128(s + 1));
+		_mm_stream_si128(d + 2, _mm_loadu_si128(s + 2));
+		_mm_stream_si128(d + 3, _mm_loadu_si128(s + 3));
+	}
+#endif
+	memcpy(dst, src, size);
+}
+
+/*
+ * Copies a row out of write-combined memory, where every load is a memory access, with the
+ * widest loads available.
+ */
+static void copy_row_from_uncached(uint8_t *dst, const uint8_t *src, size_t size)
+{
+#if defined(__ARM_NEON)
+	for (; size >= WIDE_COPY_BYTES; size -= WIDE_COPY_BYTES, src += WIDE_COPY_BYTES, dst += WIDE_COPY_BYTES)
+	{
+		const uint8x16_t v0 = vld1q_u8(src);
+		const uint8x16_t v1 = vld1q_u8(src + 16);
+		const uint8x16_t v2 = vld1q_u8(src + 32);
+		const uint8x16_t v3 = vld1q_u8(src + 48);
+		vst1q_u8(dst, v0);
+		vst1q_u8(dst + 16, v1);
+		vst1q_u8(dst + 32, v2);
+		vst1q_u8(dst + 48, v3);
+	}
+#elif defined(__SSE2__)
+	for (; size >= WIDE_COPY_BYTES; size -= WIDE_COPY_BYTES, src += WIDE_COPY_BYTES, dst += WIDE_COPY_BYTES)
+	{
+		const __m128i *s = reinterpret_cast<const __m128i *>(src);
+		__m128i *d = reinterpret_cast<__m128i *>(dst);
+		const __m128i v0 = _mm_loadu_si128(s);
+		const __m128i v1 = _mm_loadu_si128(s + 1);
+		const __m128i v2 = _mm_loadu_si128(s + 2);
+		const __m128i v3 = _mm_loadu_si128(s + 3);
+		_mm_storeu_si128(d, v0);
+		_mm_storeu_si128(d + 1, v1);
+		_mm_storeu_si128(d + 2, v2);
+		_mm_storeu_si128(d + 3, v3);
+	}
+#endif
+	memcpy(dst, src, size);
+}
+
+using copy_row_t = void (*)(uint8_t *dst, const uint8_t *src, size_t size);
+
+static void copy_row_cached(uint8_t *dst, const uint8_t *src, size_t size)
+{
+	memcpy(dst, src, size);
+}
+
+/*
+ * Checks the copy against the layout of the plane.
+ *
+ * @return Offset of the first byte of the rectangle in the buffer, with its row size and the
+ *         stride of the plane; -errno, otherwise.
+ */
+static int64_t get_plane_rect(const private_handle_t *hnd, const uint32_t plane, const int x, const int y,
+                              const int w, const int h, size_t *row_size, size_t *plane_stride)
+{
+	const auto alloc_format = hnd->get_alloc_format();
+	const auto *format_info = alloc_format.get_base_info();
+	if (format_info == nullptr || alloc_format.has_modifiers() || format_info->tile_size > 1 ||
+	    plane >= format_info->npln || format_info->bpp[plane] % 8 != 0)
+	{
+		MALI_GRALLOC_LOGE("Copies of plane %u of format %#" PRIx64 " are not supported", plane,
+		                  alloc_format.get_value());
+		return -EINVAL;
+	}
+
+	const plane_info_t &info = hnd->plane_info[plane];
+	if (x < 0 || y < 0 || w < 0 || h < 0 || static_cast<uint64_t>(x) + w > info.alloc_width ||
+	    static_cast<uint64_t>(y) + h > info.alloc_height)
+	{
+		MALI_GRALLOC_LOGE("Copy rectangle (%d,%d %dx%d) out of plane %u (%ux%u)", x, y, w, h, plane,
+		                  info.alloc_width, info.alloc_height);
+		return -EINVAL;
+	}
+
+	const size_t bytes_per_pixel = format_info->bpp[plane] / 8;
+	*row_size = static_cast<size_t>(w) * bytes_per_pixel;
+	*plane_stride = info.byte_stride;
+	return info.offset + static_cast<int64_t>(y) * info.byte_stride + static_cast<int64_t>(x) * bytes_per_pixel;
+}
+
+static void copy_rect(uint8_t *dst, size_t dst_stride, const uint8_t *src, size_t src_stride, size_t row_size,
+                      int h, copy_row_t copy_row)
+{
+	if (h == 0 || row_size == 0)
+	{
+		return;
+	}
+
+	/* Packed on both sides: one long row. */
+	if (dst_stride == row_size && src_stride == row_size)
+	{
+		row_size *= h;
+		h = 1;
+	}
+
+	for (int row = 0; row < h; row++, dst += dst_stride, src += src_stride)
+	{
+		copy_row(dst, src, row_size);
+	}
+
+#if !defined(__ARM_NEON) && defined(__SSE2__)
+	/* Order the streaming stores before the unlock. */
+	if (copy_row == copy_row_to_uncached)
+	{
+		_mm_sfence();
+	}
+#endif
+}
+
+int mali_gralloc_copy_from_plane(buffer_handle_t buffer, const void *vaddr, uint32_t plane, int x, int y, int w,
+                                 int h, void *dst, size_t dst_stride)
+{
+	if (private_handle_t::validate(buffer) < 0 || vaddr == nullptr || dst == nullptr)
+	{
+		return -EINVAL;
+	}
+
+	const private_handle_t *hnd = private_handle_t::downcast(buffer);
+	const int state = hnd->lock_state.load(std::memory_order_relaxed);
+	if ((state & (private_handle_t::LOCK_STATE_READ_MASK | private_handle_t::LOCK_STATE_WRITE)) == 0)
+	{
+		MALI_GRALLOC_LOGE("Copying from buffer %p, which is not locked", buffer);
+		return -EPERM;
+	}
+
+	size_t row_size, plane_stride;
+	const int64_t offset = get_plane_rect(hnd, plane, x, y, w, h, &row_size, &plane_stride);
+	if (offset < 0)
+	{
+		return offset;
+	}
+
+	const bool uncached = hnd->flags & private_handle_t::PRIV_FLAGS_USES_DBH_UNCACHED;
+	copy_rect(static_cast<uint8_t *>(dst), dst_stride, static_cast<const uint8_t *>(vaddr) + offset, plane_stride,
+	          row_size, h, uncached ? copy_row_from_uncached : copy_row_cached);
+	return 0;
+}
+
+int mali_gralloc_copy_to_plane(buffer_handle_t buffer, void *vaddr, uint32_t plane, int x, int y, int w, int h,
+                               const void *src, size_t src_stride)
+{
+	if (private_handle_t::validate(buffer) < 0 || vaddr == nullptr || src == nullptr)
+	{
+		return -EINVAL;
+	}
+
+	const private_handle_t *hnd = private_handle_t::downcast(buffer);
+	if ((hnd->lock_state.load(std::memory_order_relaxed) & private_handle_t::LOCK_STATE_WRITE) == 0)
+	{
+		MALI_GRALLOC_LOGE("Copying to buffer %p, which is not locked for write", buffer);
+		return -EPERM;
+	}
+
+	size_t row_size, plane_stride;
+	const int64_t offset = get_plane_rect(hnd, plane, x, y, w, h, &row_size, &plane_stride);
+	if (offset < 0)
+	{
+		return offset;
+	}
+
+	const bool uncached = hnd->flags & private_handle_t::PRIV_FLAGS_USES_DBH_UNCACHED;
+	copy_rect(static_cast<uint8_t *>(vaddr) + offset, plane_stride, static_cast<const uint8_t *>(src), src_stride,
+	          row_size, h, uncached ? copy_row_to_uncached : copy_row_cached);
+	return 0;
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2022 Arm Limited. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "gralloc_version.h"
+
+/*
+ * Rectangle copies between a plane of a CPU locked buffer and caller memory.
+ *
+ * Buffers in CPU uncached memory are mapped write-combined: every load goes to memory, and
+ * stores only stream well when they fill whole write-combining lines. These helpers copy rows
+ * with wide vector loads and stores, non-temporal where the CPU has them, for such buffers, and
+ * with memcpy() for cached ones. Rows are merged into a single copy when both sides are packed.
+ *
+ * Only uncompressed, untiled planes with a whole number of bytes per pixel are supported.
+ *
+ * These are meant for the software YUV converters of the platform, which link libgralloc_core
+ * and include this header through libgralloc_headers, and lock the buffers in process.
+ *
+ * @param buffer     [in]  The buffer, locked with mali_gralloc_lock(): for read to copy from it,
+ *                         for write to copy to it.
+ * @param vaddr      [in]  The address returned by mali_gralloc_lock().
+ * @param plane      [in]  Plane index.
+ * @param x, y, w, h [in]  Rectangle to copy, in pixels of the plane (sub-sampled for chroma).
+ * @param dst/src    [in]  Caller memory holding the rectangle.
+ * @param dst_stride/src_stride
+ *                   [in]  Bytes between two rows of the caller memory.
+ *
+ * @return 0, on success;
+ *         -EINVAL, for an invalid buffer, an unsupported plane or a rectangle out of the plane;
+ *         -EPERM, when the buffer is not locked for the access.
+ */
+int mali_gralloc_copy_from_plane(buffer_handle_t buffer, const void *vaddr, uint32_t plane, int x, int y, int w,
+                                 int h, void *dst, size_t dst_stride);
+int mali_gralloc_copy_to_plane(buffer_handle_t buffer, void *vaddr, uint32_t plane, int x, int y, int w, int h,
+                               const void *src, size_t src_stride);
@@ -41,6 +41,13 @@ struct buffer_descriptor_t
 	std::string name{"Unnamed"};
 	uint64_t reserved_size{};
 
+	/*
+	 * Hint that the buffer will be read by the CPU often although its usage does not say
+	 * so, learned from earlier buffers (see hidl_common/heap_policy.h). Backends choosing
+	 * between CPU cached and uncached memory then pick cached memory.
+	 */
+	bool prefer_cpu_cached{};
+
 	/*
 	 * Calculated values that will be passed to the allocator in order to
 	 * allocate the buffer.
@@ -16,6 +16,7 @@
  * limitations under the License.
  */
 #include <inttypes.h>
+#include <array>
 #include "helper_functions.h"
 #include "gralloc/formats.h"
 #include "format_info.h"
@@ -910,6 +911,91 @@ const std::vector<format_info_t> &get_all_base_formats()
 }
 
 
+/*
+ * Dense index tables over the base format ID space, so that the lookups below are a single
+ * array access instead of a scan of the tables above. They are built from those tables on
+ * first use, which keeps the tables above the only place formats are described.
+ */
+class format_index_tables
+{
+public:
+	/* Base format IDs, including the remapped ones, are all below this. */
+	static constexpr size_t id_space = MALI_GRALLOC_INTFMT_FMT_MASK + 1;
+
+	format_index_tables()
+	{
+		info_index.fill(no_entry);
+		ip_support_index.fill(no_entry);
+
+		/* Where an ID appears more than once, the first entry wins as with a linear scan. */
+		for (size_t i = formats.size(); i-- > 0;)
+		{
+			if (formats[i].id < id_space)
+			{
+				info_index[formats[i].id] = i;
+			}
+		}
+
+		for (size_t i = std::size(formats_ip_support); i-- > 0;)
+		{
+			if (formats_ip_support[i].id < id_space)
+			{
+				ip_support_index[formats_ip_support[i].id] = i;
+			}
+		}
+
+		for (uint32_t id = 0; id < id_space; id++)
+		{
+			internal_format[id] = id;
+		}
+		for (size_t i = std::size(hal_to_internal_format); i-- > 0;)
+		{
+			if (hal_to_internal_format[i].hal_format < id_space)
+			{
+				internal_format[hal_to_internal_format[i].hal_format] = hal_to_internal_format[i].internal_format;
+			}
+		}
+	}
+
+	const format_info_t *find_info(uint32_t base_format) const
+	{
+		if (base_format >= id_space || info_index[base_format] == no_entry)
+		{
+			return nullptr;
+		}
+		return &formats[info_index[base_format]];
+	}
+
+	const format_ip_support_t *find_ip_support(uint32_t base_format) const
+	{
+		if (base_format >= id_space || ip_support_index[base_format] == no_entry)
+		{
+			return nullptr;
+		}
+		return &formats_ip_support[ip_support_index[base_format]];
+	}
+
+	/* Maps a HAL format in the ID space to the internal format, other formats to themselves. */
+	uint32_t map_to_internal(uint32_t base_format) const
+	{
+		return internal_format[base_format];
+	}
+
+private:
+	static constexpr uint16_t no_entry = UINT16_MAX;
+
+	std::array<uint16_t, id_space> info_index;
+	std::array<uint16_t, id_space> ip_support_index;
+	std::array<uint32_t, id_space> internal_format;
+};
+
+static const format_index_tables &get_format_index_tables()
+{
+	static const format_index_tables tables;
+	return tables;
+}
+
+
 /**
  * @brief Find information for the specified base format
  *
@@ -920,12 +1006,10 @@ const std::vector<format_info_t> &get_all_base_formats()
  */
 const format_info_t *get_format_info(const uint32_t base_format)
 {
-	for (const auto &format : formats)
+	const auto *format = get_format_index_tables().find_info(base_format);
+	if (format != nullptr)
 	{
-		if (format.id == base_format)
-		{
-			return &format;
-		}
+		return format;
 	}
 
 	MALI_GRALLOC_LOGE("ERROR: Format allocation info not found for format: %" PRIx32, base_format);
@@ -935,12 +1019,10 @@ const format_info_t *get_format_info(const uint32_t base_format)
 
 const format_ip_support_t *get_format_ip_support(const uint32_t base_format)
 {
-	for (const auto &table_entry : formats_ip_support)
+	const auto *table_entry = get_format_index_tables().find_ip_support(base_format);
+	if (table_entry != nullptr)
 	{
-		if (table_entry.id == base_format)
-		{
-			return &table_entry;
-		}
+		return table_entry;
 	}
 
 	MALI_GRALLOC_LOGE("ERROR: IP support not found for format: %" PRIx32, base_format);
@@ -962,12 +1044,20 @@ uint32_t get_internal_format(const uint32_t base_format)
 {
 	uint32_t internal_format = base_format;
 
-	for (const auto &table_entry : hal_to_internal_format)
+	if (base_format < format_index_tables::id_space)
+	{
+		internal_format = get_format_index_tables().map_to_internal(base_format);
+	}
+	else
 	{
-		if (table_entry.hal_format == base_format)
+		/* HAL formats with large values (e.g. YV12), remapped into the ID space. */
+		for (const auto &table_entry : hal_to_internal_format)
 		{
-			internal_format = table_entry.internal_format;
-			break;
+			if (table_entry.hal_format == base_format)
+			{
+				internal_format = table_entry.internal_format;
+				break;
+			}
 		}
 	}
 
@@ -25,3 +25,9 @@ void mali_gralloc_adjust_dimensions(internal_format_t format, uint64_t usage, in
 internal_format_t mali_gralloc_select_format(mali_gralloc_android_format req_format, uint64_t usage, const int buffer_size);
 
 bool is_base_format_used_by_rk_video(const uint32_t base_format);
+
+/*
+ * Framebuffer resolution (w x h, in pixels), or 0 until the first framebuffer is allocated.
+ * The format selected for small buffers depends on it.
+ */
+int get_fb_size(void);
@@ -35,6 +35,7 @@
 #include "buffer_allocation.h"
 #include "format_info.h"
 #include "format_selection.h"
+#include "runtime_config.h"
 #include "capabilities/capabilities.h"
 
 /*
@@ -381,9 +382,9 @@ bool is_base_format_used_by_rk_video(const uint32_t base_format)
  */
 static inline bool is_afbc_multiplane_supported(const producers_t producers, const consumers_t consumers)
 {
-	return ip_t::support(producers, consumers, "AFBC_16X16") &&
-	       ip_t::support(producers, consumers, "AFBC_TILED_HEADERS") &&
-	       ip_t::support(producers, consumers, "AFBC_64X4") &&
+	return ip_t::support(producers, consumers, capability_feature::AFBC_16X16) &&
+	       ip_t::support(producers, consumers, capability_feature::AFBC_TILED_HEADERS) &&
+	       ip_t::support(producers, consumers, capability_feature::AFBC_64X4) &&
 	       producers.empty();
 }
 
@@ -413,7 +414,7 @@ static format_support_flags is_format_supported(const format_info_t &fmt_info, c
 	/* Determine whether producers/consumers support required AFBC features. */
 	if (f_flags & F_AFBC)
 	{
-		if (!fmt_info.afbc || !ip_t::support(producers, consumers, "AFBC_16X16"))
+		if (!fmt_info.afbc || !ip_t::support(producers, consumers, capability_feature::AFBC_16X16))
 		{
 			f_flags &= ~F_AFBC;
 		}
@@ -426,14 +427,14 @@ static format_support_flags is_format_supported(const format_info_t &fmt_info, c
 
 		/* Apply some additional restrictions from producers and consumers */
 		/* Some modifiers affect base format support */
-		if (fmt_info.is_yuv && !ip_t::support(producers, consumers, "AFBC_YUV"))
+		if (fmt_info.is_yuv && !ip_t::support(producers, consumers, capability_feature::AFBC_YUV))
 		{
 			f_flags &= ~F_AFBC;
 		}
 
 		if (gralloc_usage_is_frontbuffer(usage))
 		{
-			if (!ip_t::support(producers, consumers, "AFBC_DOUBLE_BODY"))
+			if (!ip_t::support(producers, consumers, capability_feature::AFBC_DOUBLE_BODY))
 			{
 				f_flags &= ~F_AFBC;
 			}
@@ -441,8 +442,8 @@ static format_support_flags is_format_supported(const format_info_t &fmt_info, c
 	}
 	if (f_flags & F_AFRC)
 	{
-		if (!fmt_info.afrc || (!ip_t::support(producers, consumers, "AFRC_ROT_LAYOUT") &&
-		                       !ip_t::support(producers, consumers, "AFRC_SCAN_LAYOUT")))
+		if (!fmt_info.afrc || (!ip_t::support(producers, consumers, capability_feature::AFRC_ROT_LAYOUT) &&
+		                       !ip_t::support(producers, consumers, capability_feature::AFRC_SCAN_LAYOUT)))
 		{
 			f_flags &= ~F_AFRC;
 		}
@@ -453,11 +454,11 @@ static format_support_flags is_format_supported(const format_info_t &fmt_info, c
 		{
 			f_flags &= ~F_BL_YUV;
 		}
-		else if (fmt_info.bps == 8 && !ip_t::support(producers, consumers, "YUV_BL_8"))
+		else if (fmt_info.bps == 8 && !ip_t::support(producers, consumers, capability_feature::YUV_BL_8))
 		{
 			f_flags &= ~F_BL_YUV;
 		}
-		else if (fmt_info.bps == 10 && !ip_t::support(producers, consumers, "YUV_BL_10"))
+		else if (fmt_info.bps == 10 && !ip_t::support(producers, consumers, capability_feature::YUV_BL_10))
 		{
 			f_flags &= ~F_BL_YUV;
 		}
@@ -465,17 +466,17 @@ static format_support_flags is_format_supported(const format_info_t &fmt_info, c
 	if (f_flags != F_NONE)
 	{
 		if (fmt_info.id == MALI_GRALLOC_FORMAT_INTERNAL_RGBA_1010102 &&
-		    !ip_t::support(producers, consumers, "FORMAT_R10G10B10A2"))
+		    !ip_t::support(producers, consumers, capability_feature::FORMAT_R10G10B10A2))
 		{
 			f_flags = F_NONE;
 		}
 		else if (fmt_info.id == MALI_GRALLOC_FORMAT_INTERNAL_RGBA_16161616)
 		{
-			if (!ip_t::support(producers, consumers, "FORMAT_R16G16B16A16_FLOAT"))
+			if (!ip_t::support(producers, consumers, capability_feature::FORMAT_R16G16B16A16_FLOAT))
 			{
 				f_flags = F_NONE;
 			}
-			else if (!ip_t::support(producers, consumers, "AFBC_FORMAT_R16G16B16A16_FLOAT"))
+			else if (!ip_t::support(producers, consumers, capability_feature::AFBC_FORMAT_R16G16B16A16_FLOAT))
 			{
 				f_flags = F_LIN;
 			}
@@ -537,7 +538,7 @@ static internal_format_t validate_afbc_format(internal_format_t alloc_format, co
 		/* Enable split-block if supported by producer(s) & consumer(s),
 		 * otherwise disable wide-block.
 		 */
-		if (ip_t::support(producers, consumers, "AFBC_BLOCK_SPLIT"))
+		if (ip_t::support(producers, consumers, capability_feature::AFBC_BLOCK_SPLIT))
 		{
 			alloc_format.set_afbc_block_split();
 		}
@@ -554,32 +555,32 @@ static internal_format_t validate_afbc_format(internal_format_t alloc_format, co
 	}
 
 	/* Ensure that AFBC features are supported by producers/consumers. */
-	if (alloc_format.is_afbc() && !ip_t::support(producers, consumers, "AFBC_16X16"))
+	if (alloc_format.is_afbc() && !ip_t::support(producers, consumers, capability_feature::AFBC_16X16))
 	{
 		MALI_GRALLOC_LOGE("AFBC basic selected but not supported by producer/consumer. Disabling AFBC");
 		alloc_format.clear_modifiers();
 	}
 
-	if (alloc_format.get_afbc_block_split() && !ip_t::support(producers, consumers, "AFBC_BLOCK_SPLIT"))
+	if (alloc_format.get_afbc_block_split() && !ip_t::support(producers, consumers, capability_feature::AFBC_BLOCK_SPLIT))
 	{
 		MALI_GRALLOC_LOGE("AFBC split-block selected but not supported by producer/consumer. Disabling split-block");
 		alloc_format.set_afbc_block_split(false);
 	}
 
-	if (alloc_format.get_afbc_32x8() && !ip_t::support(producers, consumers, "AFBC_32X8"))
+	if (alloc_format.get_afbc_32x8() && !ip_t::support(producers, consumers, capability_feature::AFBC_32X8))
 	{
 		MALI_GRALLOC_LOGE("AFBC wide-block selected but not supported by producer/consumer. Disabling wide-block");
 		alloc_format.set_afbc_32x8(false);
 	}
 
-	if (alloc_format.get_afbc_tiled_headers() && !ip_t::support(producers, consumers, "AFBC_TILED_HEADERS"))
+	if (alloc_format.get_afbc_tiled_headers() && !ip_t::support(producers, consumers, capability_feature::AFBC_TILED_HEADERS))
 	{
 		MALI_GRALLOC_LOGE("AFBC tiled-headers selected but not supported by producer/consumer. "
 		                  "Disabling tiled-headers");
 		alloc_format.set_afbc_tiled_headers(false);
 	}
 
-	if (!alloc_format.get_afbc_sparse() && (!producers.support("AFBC_WRITE_NON_SPARSE") || producers.empty()))
+	if (!alloc_format.get_afbc_sparse() && (!producers.support(capability_feature::AFBC_WRITE_NON_SPARSE) || producers.empty()))
 	{
 		MALI_GRALLOC_LOGE("AFBC sparse not selected while producer cannot write non-sparse. Enabling AFBC sparse");
 		alloc_format.set_afbc_sparse();
@@ -605,12 +606,12 @@ static internal_format_t get_afrc_format(const format_info_t &format, const uint
 	auto base_format = internal_format_t::from_android(format.id);
 	auto alloc_format = base_format;
 
-	if (ip_t::support(producers, consumers, "AFRC_ROT_LAYOUT"))
+	if (ip_t::support(producers, consumers, capability_feature::AFRC_ROT_LAYOUT))
 	{
 		alloc_format.make_afrc();
 		alloc_format.set_afrc_rot_layout();
 	}
-	else if (ip_t::support(producers, consumers, "AFRC_SCAN_LAYOUT"))
+	else if (ip_t::support(producers, consumers, capability_feature::AFRC_SCAN_LAYOUT))
 	{
 		alloc_format.make_afrc();
 	}
@@ -683,12 +684,12 @@ static internal_format_t get_afbc_format(const format_info_t &format, const uint
 	if (format.is_yuv)
 	{
 		/* Avoid AFBC if format is YUV and any of the consumers cannot read AFBC YUV. */
-		if (!consumers.empty() && !consumers.support("AFBC_YUV"))
+		if (!consumers.empty() && !consumers.support(capability_feature::AFBC_YUV))
 		{
 			return base_format;
 		}
 		/* Avoid AFBC if format is YUV and producer cannot write AFBC YUV. */
-		if (!producers.support("AFBC_YUV"))
+		if (!producers.support(capability_feature::AFBC_YUV))
 		{
 			return base_format;
 		}
@@ -704,7 +705,7 @@ static internal_format_t get_afbc_format(const format_info_t &format, const uint
 	 * Determine AFBC modifiers where capabilities are defined for all producers
 	 * and consumers.
 	 */
-	if (!ip_t::support(producers, consumers, "AFBC_16X16"))
+	if (!ip_t::support(producers, consumers, capability_feature::AFBC_16X16))
 	{
 		return base_format;
 	}
@@ -713,17 +714,17 @@ static internal_format_t get_afbc_format(const format_info_t &format, const uint
 	alloc_format.make_afbc();
 	alloc_format.set_afbc_yuv_transform(format.yuv_transform);
 
-	if (producers.empty() || !producers.support("AFBC_WRITE_NON_SPARSE"))
+	if (producers.empty() || !producers.support(capability_feature::AFBC_WRITE_NON_SPARSE))
 	{
 		alloc_format.set_afbc_sparse();
 	}
 
 
-	if (ip_t::support(producers, consumers, "AFBC_TILED_HEADERS"))
+	if (ip_t::support(producers, consumers, capability_feature::AFBC_TILED_HEADERS))
 	{
 		alloc_format.set_afbc_tiled_headers();
 
-		if (gralloc_usage_is_frontbuffer(usage) && ip_t::support(producers, consumers, "AFBC_DOUBLE_BODY"))
+		if (gralloc_usage_is_frontbuffer(usage) && ip_t::support(producers, consumers, capability_feature::AFBC_DOUBLE_BODY))
 		{
 			alloc_format.set_afbc_double_body();
 		}
@@ -736,7 +737,7 @@ static internal_format_t get_afbc_format(const format_info_t &format, const uint
 	    ip_t::present(MALI_GRALLOC_IP_DPU))
 	{
 		/* AFBC wide-block is not supported across IP for YUV formats. */
-		if (ip_t::support(producers, consumers, "AFBC_32X8") && !format.is_yuv)
+		if (ip_t::support(producers, consumers, capability_feature::AFBC_32X8) && !format.is_yuv)
 		{
 			/* NOTE: assume that all AFBC layers are pre-rotated. 16x16 SB must be used with
 			 * DPU consumer when rotation is required.
@@ -744,7 +745,7 @@ static internal_format_t get_afbc_format(const format_info_t &format, const uint
 			alloc_format.set_afbc_32x8();
 		}
 
-		if (ip_t::support(producers, consumers, "AFBC_BLOCK_SPLIT"))
+		if (ip_t::support(producers, consumers, capability_feature::AFBC_BLOCK_SPLIT))
 		{
 			bool enable_split_block = true;
 
@@ -774,7 +775,7 @@ static internal_format_t get_bl_format(const internal_format_t base_format, cons
                                        const consumers_t consumers)
 {
 	internal_format_t alloc_format = base_format;
-	if (ip_t::support(producers, consumers, "YUV_BL_8") || ip_t::support(producers, consumers, "YUV_BL_10"))
+	if (ip_t::support(producers, consumers, capability_feature::YUV_BL_8) || ip_t::support(producers, consumers, capability_feature::YUV_BL_10))
 	{
 		alloc_format.make_block_linear();
 	}
@@ -1344,25 +1345,16 @@ static bool is_rk_ext_hal_format(const uint64_t hal_format)
 
 static bool is_no_afbc_for_sf_client_layer_required_via_prop()
 {
-	char value[PROPERTY_VALUE_MAX];
-
-	property_get("vendor.gralloc.no_afbc_for_sf_client_layer", value, "0");
-
-	return (0 == strcmp("1", value) );
+	return get_runtime_config().no_afbc_for_sf_client_layer();
 }
 
 static bool is_no_afbc_for_fb_target_layer_required_via_prop()
 {
-	char value[PROPERTY_VALUE_MAX];
-
-	property_get("vendor.gralloc.no_afbc_for_fb_target_layer", value, "0");
-
-	return (0 == strcmp("1", value) );
+	return get_runtime_config().no_afbc_for_fb_target_layer();
 }
 
 #define PROP_NAME_OF_FB_SIZE	"vendor.gralloc.fb_size"
 
-static int get_fb_size(void);
 /* framebuffer resolution (w x h, in pixels). */
 static int s_fb_size;
 
@@ -1389,7 +1381,7 @@ static void save_fb_size(int fb_size)
 	property_set(PROP_NAME_OF_FB_SIZE, fb_size_in_str);
 }
 
-static int get_fb_size(void)
+int get_fb_size(void)
 {
 	char fb_size_in_str[PROPERTY_VALUE_MAX];
 
@@ -1406,11 +1398,7 @@ static int get_fb_size(void)
 
 static bool is_not_to_use_non_afbc_for_small_buffers_required_via_prop()
 {
-	char value[PROPERTY_VALUE_MAX];
-
-	property_get("vendor.gralloc.not_to_use_non_afbc_for_small_buffers", value, "0");
-
-	return (0 == strcmp("1", value) );
+	return get_runtime_config().not_to_use_non_afbc_for_small_buffers();
 }
 
 /*
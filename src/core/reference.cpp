@@ -17,7 +17,6 @@
  */
 
 #include <hardware/gralloc1.h>
-#include <mutex>
 
 #include "private_interface_types.h"
 #include "buffer.h"
@@ -27,10 +26,6 @@
 #include "gralloc_version.h"
 #include "buffer_access.h"
 
-using scoped_mutex = std::lock_guard<std::mutex>;
-
-static std::mutex s_map_lock;
-
 int mali_gralloc_reference_retain(buffer_handle_t handle)
 {
 	if (private_handle_t::validate(handle) < 0)
@@ -40,10 +35,11 @@ int mali_gralloc_reference_retain(buffer_handle_t handle)
 	}
 
 	private_handle_t *hnd = (private_handle_t *)handle;
-	scoped_mutex lock(s_map_lock);
 
 	/* Ensure the state is valid for newly registered buffers */
 	hnd->base = nullptr;
+	hnd->lock_state.store(0, std::memory_order_relaxed);
+	hnd->lock_left = hnd->lock_top = hnd->lock_right = hnd->lock_bottom = 0;
 	if (hnd->allocating_pid != getpid() && hnd->remote_pid != getpid())
 	{
 		hnd->remote_pid = getpid();
@@ -61,7 +57,6 @@ int mali_gralloc_reference_release(buffer_handle_t handle)
 	}
 
 	private_handle_t *hnd = (private_handle_t *)handle;
-	scoped_mutex lock(s_map_lock);
 
 	if (hnd->allocating_pid == getpid())
 	{
@@ -72,7 +67,7 @@ int mali_gralloc_reference_release(buffer_handle_t handle)
 	}
 	else if (hnd->remote_pid == getpid()) // never unmap buffers that were not imported into this process
 	{
-		mali_unmap_buffer(hnd);
+		mali_release_buffer_mapping(hnd);
 
 		/*
 		 * Close shared attribute region file descriptor. It might seem strange to "free"
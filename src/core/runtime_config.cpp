@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2022 Arm Limited. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstring>
+#include <mutex>
+
+#include <cutils/properties.h>
+#if !GRALLOC_HOST_BUILD
+#include <sys/system_properties.h>
+#endif
+
+#include "runtime_config.h"
+#include "log.h"
+
+static runtime_config s_config;
+static std::mutex s_reload_lock;
+
+static uint32_t get_property_serial()
+{
+#if !GRALLOC_HOST_BUILD
+	/* Changes whenever any system property is set. This is a single load from the property area. */
+	return __system_property_area_serial();
+#else
+	return 0;
+#endif
+}
+
+/* Stores 'value', returning whether it differs from the previous one. */
+template <typename T, typename V>
+static bool update(std::atomic<T> &option, V value)
+{
+	return option.exchange(static_cast<T>(value), std::memory_order_relaxed) != static_cast<T>(value);
+}
+
+/*
+ * Whether the property is set to exactly "1". This is how the properties which predate the
+ * runtime configuration have always been read: "true" or "y" do not enable them.
+ */
+static bool property_is_one(const char *name)
+{
+	char value[PROPERTY_VALUE_MAX];
+	property_get(name, value, "0");
+
+	return strcmp(value, "1") == 0;
+}
+
+void runtime_config::load()
+{
+	/* Take the serial first so that a property set while reading is picked up by the next check. */
+	m_property_serial.store(get_property_serial(), std::memory_order_relaxed);
+
+	/*
+	 * The serial changes with any system property, so most reloads find the same values. Users
+	 * only see a new generation, and drop what they derived from the configuration, when one
+	 * of the vendor.gralloc.* properties actually changed.
+	 */
+	bool changed = m_generation.load(std::memory_order_relaxed) == 0;
+	changed |= update(m_alloc_all_buffers_from_cma_heap,
+	                  property_is_one("vendor.gralloc.alloc_all_buf_from_cma_heap"));
+	changed |= update(m_no_afbc_for_sf_client_layer,
+	                  property_is_one("vendor.gralloc.no_afbc_for_sf_client_layer"));
+	changed |= update(m_no_afbc_for_fb_target_layer,
+	                  property_is_one("vendor.gralloc.no_afbc_for_fb_target_layer"));
+	changed |= update(m_not_to_use_non_afbc_for_small_buffers,
+	                  property_is_one("vendor.gralloc.not_to_use_non_afbc_for_small_buffers"));
+	changed |= update(m_dmabuf_pool_budget_bytes,
+	                  property_get_int64("vendor.gralloc.dmabuf_pool_budget_kb", 0) * 1024);
+	changed |= update(m_dmabuf_pool_idle_timeout_ms,
+	                  property_get_int64("vendor.gralloc.dmabuf_pool_idle_timeout_ms", 3000));
+	changed |= update(m_mapping_cache_budget_bytes,
+	                  property_get_int64("vendor.gralloc.mapping_cache_budget_kb", 0) * 1024);
+	changed |= update(m_skip_uncached_sync, property_get_bool("vendor.gralloc.skip_uncached_sync", false));
+	changed |= update(m_prefault_mappings, property_get_bool("vendor.gralloc.prefault_mappings", false));
+	changed |= update(m_adaptive_heap, property_get_bool("vendor.gralloc.adaptive_heap", false));
+
+	if (changed)
+	{
+		m_generation.fetch_add(1, std::memory_order_release);
+		MALI_GRALLOC_LOGV("runtime configuration changed, generation %u",
+		                  m_generation.load(std::memory_order_relaxed));
+	}
+}
+
+const runtime_config &get_runtime_config()
+{
+	if (s_config.m_generation.load(std::memory_order_acquire) == 0
+	    || s_config.m_property_serial.load(std::memory_order_relaxed) != get_property_serial())
+	{
+		std::lock_guard<std::mutex> lock(s_reload_lock);
+		if (s_config.m_generation.load(std::memory_order_relaxed) == 0
+		    || s_config.m_property_serial.load(std::memory_order_relaxed) != get_property_serial())
+		{
+			s_config.load();
+		}
+	}
+
+	return s_config;
+}
+
+void reload_runtime_config()
+{
+	std::lock_guard<std::mutex> lock(s_reload_lock);
+	s_config.load();
+}
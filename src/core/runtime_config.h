@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2022 Arm Limited. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+
+/*
+ * Snapshot of the vendor.gralloc.* properties tuning gralloc at runtime.
+ *
+ * The properties are read once and then served as plain loads, so they can be queried on
+ * the allocation hot path. The snapshot is re-read when the system property area reports
+ * that any property changed since it was taken, or on reload_runtime_config().
+ */
+class runtime_config
+{
+public:
+	/* vendor.gralloc.alloc_all_buf_from_cma_heap */
+	bool alloc_all_buffers_from_cma_heap() const
+	{
+		return m_alloc_all_buffers_from_cma_heap.load(std::memory_order_relaxed);
+	}
+
+	/* vendor.gralloc.no_afbc_for_sf_client_layer */
+	bool no_afbc_for_sf_client_layer() const
+	{
+		return m_no_afbc_for_sf_client_layer.load(std::memory_order_relaxed);
+	}
+
+	/* vendor.gralloc.no_afbc_for_fb_target_layer */
+	bool no_afbc_for_fb_target_layer() const
+	{
+		return m_no_afbc_for_fb_target_layer.load(std::memory_order_relaxed);
+	}
+
+	/* vendor.gralloc.not_to_use_non_afbc_for_small_buffers */
+	bool not_to_use_non_afbc_for_small_buffers() const
+	{
+		return m_not_to_use_non_afbc_for_small_buffers.load(std::memory_order_relaxed);
+	}
+
+	/* vendor.gralloc.dmabuf_pool_budget_kb, in bytes. */
+	uint64_t dmabuf_pool_budget_bytes() const
+	{
+		return m_dmabuf_pool_budget_bytes.load(std::memory_order_relaxed);
+	}
+
+	/* vendor.gralloc.dmabuf_pool_idle_timeout_ms */
+	uint64_t dmabuf_pool_idle_timeout_ms() const
+	{
+		return m_dmabuf_pool_idle_timeout_ms.load(std::memory_order_relaxed);
+	}
+
+	/* vendor.gralloc.mapping_cache_budget_kb, in bytes. 0, the default, disables the mapping cache. */
+	uint64_t mapping_cache_budget_bytes() const
+	{
+		return m_mapping_cache_budget_bytes.load(std::memory_order_relaxed);
+	}
+
+	/*
+	 * vendor.gralloc.skip_uncached_sync. Only safe when no device attaches implicit fences to
+	 * the buffers: DMA_BUF_IOCTL_SYNC also waits for those before starting CPU access.
+	 */
+	bool skip_uncached_sync() const
+	{
+		return m_skip_uncached_sync.load(std::memory_order_relaxed);
+	}
+
+	/* vendor.gralloc.prefault_mappings */
+	bool prefault_mappings() const
+	{
+		return m_prefault_mappings.load(std::memory_order_relaxed);
+	}
+
+	/* vendor.gralloc.adaptive_heap */
+	bool adaptive_heap() const
+	{
+		return m_adaptive_heap.load(std::memory_order_relaxed);
+	}
+
+	/*
+	 * Incremented every time a re-read of the snapshot finds a changed value. Users deriving
+	 * state from the configuration compare it against the value they last saw.
+	 */
+	uint32_t generation() const
+	{
+		return m_generation.load(std::memory_order_acquire);
+	}
+
+private:
+	friend const runtime_config &get_runtime_config();
+	friend void reload_runtime_config();
+
+	void load();
+
+	std::atomic<bool> m_alloc_all_buffers_from_cma_heap{false};
+	std::atomic<bool> m_no_afbc_for_sf_client_layer{false};
+	std::atomic<bool> m_no_afbc_for_fb_target_layer{false};
+	std::atomic<bool> m_not_to_use_non_afbc_for_small_buffers{false};
+	std::atomic<uint64_t> m_dmabuf_pool_budget_bytes{0};
+	std::atomic<uint64_t> m_dmabuf_pool_idle_timeout_ms{0};
+	std::atomic<uint64_t> m_mapping_cache_budget_bytes{0};
+	std::atomic<bool> m_skip_uncached_sync{false};
+	std::atomic<bool> m_prefault_mappings{false};
+	std::atomic<bool> m_adaptive_heap{false};
+	std::atomic<uint32_t> m_generation{0};
+
+	/* Serial of the system property area when the snapshot was taken. */
+	std::atomic<uint32_t> m_property_serial{0};
+};
+
+/*
+ * Returns the runtime configuration, re-reading it first if a system property changed.
+ */
+const runtime_config &get_runtime_config();
+
+/*
+ * Unconditionally re-reads the runtime configuration.
+ */
+void reload_runtime_config();
@@ -19,8 +19,12 @@
 // #define ENABLE_DEBUG_LOG
 #include "../custom_log.h"
 
+#include <atomic>
+#include <chrono>
+
 #include "allocator.h"
 #include "shared_metadata.h"
+#include "heap_policy.h"
 
 #include "core/buffer_allocation.h"
 #include "core/buffer_descriptor.h"
@@ -39,6 +43,19 @@ namespace common
 
 using aidl::android::hardware::graphics::common::ExtendableType;
 
+static void log_allocate_latency(uint32_t count, uint64_t latency_ns, bool success)
+{
+	MALI_GRALLOC_LOGV("Allocated %u buffer(s) in %" PRIu64 " us%s", count, latency_ns / 1000,
+	                  success ? "" : " (failed)");
+}
+
+static std::atomic<allocate_timing_hook_t> s_allocate_timing_hook{log_allocate_latency};
+
+void set_allocate_timing_hook(allocate_timing_hook_t hook)
+{
+	s_allocate_timing_hook.store(hook != nullptr ? hook : log_allocate_latency, std::memory_order_relaxed);
+}
+
 /* Get the default chroma siting to use based on the format. */
 static void get_format_default_chroma_siting(internal_format_t format, ExtendableType *chroma_siting)
 {
@@ -89,44 +106,60 @@ void allocate(buffer_descriptor_t *bufferDescriptor, uint32_t count, IAllocator:
 {
 	Error error = Error::NONE;
 	int stride = 0;
+	std::vector<private_handle_t *> handles(count, nullptr);
 	std::vector<hidl_handle> grallocBuffers;
 
-	grallocBuffers.reserve(count);
+	const auto start_time = std::chrono::steady_clock::now();
+
+	heap_policy_apply(bufferDescriptor);
+
+	/*
+	 * All the buffers share the descriptor, so the format and size are derived once and the
+	 * backing stores allocated in one go.
+	 */
+	if (count > 0 && mali_gralloc_buffer_allocate_batch(bufferDescriptor, count, handles.data()) != 0)
+	{
+		MALI_GRALLOC_LOGE("%s, buffer allocation failed with %d", __func__, errno);
+		handles.clear();
+		error = Error::NO_RESOURCES;
+	}
 
-	for (uint32_t i = 0; i < count; i++)
+	/* Properties of the shared metadata common to the whole batch. */
+	const auto internal_format = bufferDescriptor->alloc_format;
+	const uint64_t usage = bufferDescriptor->consumer_usage | bufferDescriptor->producer_usage;
+	android_dataspace_t dataspace = HAL_DATASPACE_UNKNOWN;
+	mali_gralloc_yuv_info yuv_info = MALI_YUV_NO_INFO;
+	ExtendableType chroma_siting;
+	if (error == Error::NONE)
 	{
-		private_handle_t *hnd = nullptr;
-		if (mali_gralloc_buffer_allocate(bufferDescriptor, &hnd) != 0)
-		{
-			MALI_GRALLOC_LOGE("%s, buffer allocation failed with %d", __func__, errno);
-			error = Error::NO_RESOURCES;
-			break;
-		}
+		get_format_dataspace(internal_format.get_base_info(), usage, bufferDescriptor->width,
+		                     bufferDescriptor->height, &dataspace, &yuv_info);
+		get_format_default_chroma_siting(internal_format, &chroma_siting);
+		stride = bufferDescriptor->pixel_stride;
+	}
+
+	const uint64_t attr_size =
+	    mapper::common::shared_metadata_size(bufferDescriptor->name, bufferDescriptor->reserved_size);
+	for (size_t i = 0; i < handles.size() && error == Error::NONE; i++)
+	{
+		private_handle_t *hnd = handles[i];
 
 		hnd->imapper_version = HIDL_MAPPER_VERSION_SCALED;
+		hnd->yuv_info = yuv_info;
 
 		hnd->reserved_region_size = bufferDescriptor->reserved_size;
-		hnd->attr_size = mapper::common::shared_metadata_size() + hnd->reserved_region_size;
+		hnd->attr_size = attr_size;
 		std::tie(hnd->share_attr_fd, hnd->attr_base) =
 			gralloc_shared_memory_allocate("gralloc_shared_memory", hnd->attr_size);
 		if (hnd->share_attr_fd < 0 || hnd->attr_base == MAP_FAILED)
 		{
 			MALI_GRALLOC_LOGE("%s, shared memory allocation failed with errno %d", __func__, errno);
-			mali_gralloc_buffer_free(hnd);
 			error = Error::UNSUPPORTED;
 			break;
 		}
 
-		mapper::common::shared_metadata_init(hnd->attr_base, bufferDescriptor->name);
-		const auto internal_format = bufferDescriptor->alloc_format;
-		const uint64_t usage = bufferDescriptor->consumer_usage | bufferDescriptor->producer_usage;
-		android_dataspace_t dataspace;
-		const auto *format_info = internal_format.get_base_info();
-		get_format_dataspace(format_info, usage, hnd->width, hnd->height, &dataspace, &hnd->yuv_info);
-
-		ExtendableType chroma_siting;
-		get_format_default_chroma_siting(internal_format, &chroma_siting);
-
+		mapper::common::shared_metadata_init(hnd->attr_base, bufferDescriptor->name,
+		                                     bufferDescriptor->reserved_size);
 		mapper::common::set_dataspace(hnd, static_cast<mapper::common::Dataspace>(dataspace));
 		mapper::common::set_chroma_siting(hnd, chroma_siting);
 
@@ -136,8 +169,11 @@ void allocate(buffer_descriptor_t *bufferDescriptor, uint32_t count, IAllocator:
 		*
 		* hnd->attr_base = mmap(...);
 		* hidl_callback(hnd); // client receives hnd->attr_base = <dangling pointer>
+		*
+		* The mapping itself is handed to the heap policy, which watches the CPU locks of the
+		* buffer through it, and unmaps it when it is not interested.
 		*/
-		munmap(hnd->attr_base, hnd->attr_size);
+		heap_policy_observe(*bufferDescriptor, hnd->attr_base, hnd->attr_size);
 		hnd->attr_base = MAP_FAILED;
 
                 {
@@ -170,41 +206,37 @@ void allocate(buffer_descriptor_t *bufferDescriptor, uint32_t count, IAllocator:
 					(hnd->plane_info)[1].alloc_height);
 #endif
 		}
-
-		int tmpStride = bufferDescriptor->pixel_stride;
-
-		if (stride == 0)
-		{
-			stride = tmpStride;
-		}
-		else if (stride != tmpStride)
-		{
-			/* Stride must be the same for all allocations */
-			mali_gralloc_buffer_free(hnd);
-			stride = 0;
-			error = Error::UNSUPPORTED;
-			break;
-		}
-
-		grallocBuffers.emplace_back(hidl_handle(hnd));
 	}
 
+	s_allocate_timing_hook.load(std::memory_order_relaxed)(
+		count,
+		std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_time).count(),
+		error == Error::NONE);
+
 	/* Populate the array of buffers for application consumption */
 	hidl_vec<hidl_handle> hidlBuffers;
 	if (error == Error::NONE)
 	{
+		grallocBuffers.reserve(count);
+		for (private_handle_t *hnd : handles)
+		{
+			grallocBuffers.emplace_back(hidl_handle(hnd));
+		}
 		hidlBuffers.setToExternal(grallocBuffers.data(), grallocBuffers.size());
 	}
+	else
+	{
+		stride = 0;
+	}
 	hidl_cb(error, stride, hidlBuffers);
 
 	/* The application should import the Gralloc buffers using IMapper for
 	 * further usage. Free the allocated buffers in IAllocator context
 	 */
-	for (auto &buffer : grallocBuffers)
+	for (private_handle_t *hnd : handles)
 	{
-		const native_handle_t *native_handle = buffer.getNativeHandle();
-		mali_gralloc_buffer_free(private_handle_t::downcast(native_handle));
-		native_handle_delete(const_cast<native_handle_t *>(native_handle));
+		mali_gralloc_buffer_free(hnd);
+		native_handle_delete(hnd);
 	}
 }
 
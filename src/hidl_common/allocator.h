@@ -49,6 +49,19 @@ using android::hardware::hidl_vec;
  */
 void allocate(buffer_descriptor_t *descriptor, uint32_t count, IAllocator::allocate_cb hidl_cb);
 
+/*
+ * Hook notified after each call to allocate() with the number of buffers requested,
+ * the time spent allocating and initialising them (excluding the HIDL callback) and
+ * whether the allocation succeeded.
+ */
+using allocate_timing_hook_t = void (*)(uint32_t count, uint64_t latency_ns, bool success);
+
+/*
+ * Installs the allocation timing hook. Passing nullptr restores the default, which
+ * logs the latency at verbose level.
+ */
+void set_allocate_timing_hook(allocate_timing_hook_t hook);
+
 } // namespace common
 } // namespace allocator
 } // namespace arm
@@ -0,0 +1,294 @@
+/*
+ * Copyright (C) 2022 Arm Limited. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <inttypes.h>
+#include <list>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+#include "heap_policy.h"
+#include "shared_metadata.h"
+#include "core/runtime_config.h"
+#include "allocator/shared_memory/shared_memory.h"
+#include "log.h"
+#include "usages.h"
+
+/* Number of buffers per key whose CPU locks are observed. */
+#define HEAP_POLICY_SAMPLES_PER_KEY	4
+
+/* Number of keys the policy is learned for; the least recently allocated are dropped. */
+#define HEAP_POLICY_MAX_KEYS		64
+
+/* CPU read locks after which a buffer counts as read often. */
+#define HEAP_POLICY_READ_LOCKS_THRESHOLD	8
+
+namespace arm
+{
+namespace allocator
+{
+namespace common
+{
+
+class heap_policy
+{
+public:
+	void apply(buffer_descriptor_t *descriptor)
+	{
+		if (!is_candidate(*descriptor))
+		{
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(m_lock);
+
+		auto it = find(make_key(*descriptor));
+		if (it == m_entries.end())
+		{
+			return;
+		}
+
+		m_entries.splice(m_entries.begin(), m_entries, it);
+
+		const bool prefer_cpu_cached = learn(*it);
+		if (prefer_cpu_cached != it->prefer_cpu_cached)
+		{
+			MALI_GRALLOC_LOGI("Heap policy: %s buffers '%s' (usage %#" PRIx64 ", format %#" PRIx64 ") now %s, "
+			                  "read locks of the last buffers: %s",
+			                  prefer_cpu_cached ? "CPU read" : "no longer CPU read", it->key.name.c_str(),
+			                  it->key.usage, it->key.format,
+			                  prefer_cpu_cached ? "use CPU cached memory" : "follow their usage",
+			                  dump_read_locks(*it).c_str());
+			it->prefer_cpu_cached = prefer_cpu_cached;
+		}
+
+		descriptor->prefer_cpu_cached = it->prefer_cpu_cached;
+	}
+
+	void observe(const buffer_descriptor_t &descriptor, void *attr_base, size_t attr_size)
+	{
+		if (!is_candidate(descriptor))
+		{
+			gralloc_shared_memory_unmap(attr_base, attr_size);
+			return;
+		}
+
+		std::vector<sample> evicted;
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+
+			release_freed(&evicted);
+
+			const key_t key = make_key(descriptor);
+			auto it = find(key);
+			if (it == m_entries.end())
+			{
+				m_entries.push_front({ key, {}, false });
+				it = m_entries.begin();
+
+				if (m_entries.size() > HEAP_POLICY_MAX_KEYS)
+				{
+					for (const auto &s : m_entries.back().samples)
+					{
+						if (s.attr_base != nullptr)
+						{
+							evicted.push_back(s);
+						}
+					}
+					m_entries.pop_back();
+				}
+			}
+
+			it->samples.push_back({ attr_base, attr_size, 0 });
+			if (it->samples.size() > HEAP_POLICY_SAMPLES_PER_KEY)
+			{
+				if (it->samples.front().attr_base != nullptr)
+				{
+					evicted.push_back(it->samples.front());
+				}
+				it->samples.erase(it->samples.begin());
+			}
+		}
+
+		for (const auto &s : evicted)
+		{
+			gralloc_shared_memory_unmap(s.attr_base, s.attr_size);
+		}
+	}
+
+	std::string dump()
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+
+		std::ostringstream out;
+		out << "Adaptive heap policy: " << m_entries.size() << " key(s)\n";
+		for (const auto &e : m_entries)
+		{
+			out << "  '" << e.key.name << "' usage " << std::hex << std::showbase << e.key.usage
+			    << " format " << e.key.format << std::dec << std::noshowbase
+			    << (e.prefer_cpu_cached ? ": CPU cached" : ": by usage") << ", read locks "
+			    << dump_read_locks(e) << "\n";
+		}
+		return out.str();
+	}
+
+private:
+	struct key_t
+	{
+		std::string name;
+		uint64_t usage;
+		uint64_t format;
+
+		bool operator==(const key_t &other) const
+		{
+			return usage == other.usage && format == other.format && name == other.name;
+		}
+	};
+
+	/*
+	 * Shared metadata of a buffer, kept mapped to read its CPU lock counts while the buffer
+	 * is in use. Once it is freed, its last count is kept in read_locks and attr_base is nullptr.
+	 */
+	struct sample
+	{
+		void *attr_base;
+		size_t attr_size;
+		uint32_t read_locks;
+	};
+
+	struct entry
+	{
+		key_t key;
+		std::vector<sample> samples;
+		bool prefer_cpu_cached;
+	};
+
+	using entry_list = std::list<entry>;
+
+	/*
+	 * Only buffers whose usage leaves them in CPU uncached memory, and which can be locked
+	 * by the CPU, can benefit.
+	 */
+	static bool is_candidate(const buffer_descriptor_t &descriptor)
+	{
+		const uint64_t usage = descriptor.producer_usage | descriptor.consumer_usage;
+		return get_runtime_config().adaptive_heap() &&
+		       (usage & GRALLOC_USAGE_SW_READ_MASK) != GRALLOC_USAGE_SW_READ_OFTEN &&
+		       (usage & (GRALLOC_USAGE_PROTECTED | RK_GRALLOC_USAGE_PHY_CONTIG_BUFFER)) == 0;
+	}
+
+	static key_t make_key(const buffer_descriptor_t &descriptor)
+	{
+		return { descriptor.name, descriptor.producer_usage | descriptor.consumer_usage, descriptor.hal_format };
+	}
+
+	entry_list::iterator find(const key_t &key)
+	{
+		for (auto it = m_entries.begin(); it != m_entries.end(); ++it)
+		{
+			if (it->key == key)
+			{
+				return it;
+			}
+		}
+		return m_entries.end();
+	}
+
+	static uint32_t get_read_locks(const sample &s)
+	{
+		if (s.attr_base == nullptr)
+		{
+			return s.read_locks;
+		}
+
+		uint32_t reads, writes;
+		mapper::common::get_cpu_lock_counts(s.attr_base, &reads, &writes);
+		return reads;
+	}
+
+	/*
+	 * Moves the mappings of the samples whose buffers were freed by all their importers to
+	 * 'released', keeping their last read lock count. Called with m_lock held.
+	 */
+	void release_freed(std::vector<sample> *released)
+	{
+		for (auto &e : m_entries)
+		{
+			for (auto &s : e.samples)
+			{
+				if (s.attr_base != nullptr && mapper::common::is_buffer_released(s.attr_base))
+				{
+					s.read_locks = get_read_locks(s);
+					released->push_back(s);
+					s.attr_base = nullptr;
+				}
+			}
+		}
+	}
+
+	/* Returns the CPU read locks of the observed buffers, e.g. "[9 12 0 8]". */
+	static std::string dump_read_locks(const entry &e)
+	{
+		std::ostringstream out;
+		out << "[";
+		for (size_t i = 0; i < e.samples.size(); i++)
+		{
+			out << (i ? " " : "") << get_read_locks(e.samples[i]);
+		}
+		out << "]";
+		return out.str();
+	}
+
+	/* Most of the observed buffers were read often. */
+	static bool learn(const entry &e)
+	{
+		size_t read_often = 0;
+		for (const auto &s : e.samples)
+		{
+			if (get_read_locks(s) >= HEAP_POLICY_READ_LOCKS_THRESHOLD)
+			{
+				read_often++;
+			}
+		}
+
+		return !e.samples.empty() && read_often * 2 > e.samples.size();
+	}
+
+	std::mutex m_lock;
+	/* Most recently allocated key first. */
+	entry_list m_entries;
+};
+
+static heap_policy s_heap_policy;
+
+void heap_policy_apply(buffer_descriptor_t *descriptor)
+{
+	s_heap_policy.apply(descriptor);
+}
+
+void heap_policy_observe(const buffer_descriptor_t &descriptor, void *attr_base, size_t attr_size)
+{
+	s_heap_policy.observe(descriptor, attr_base, attr_size);
+}
+
+std::string heap_policy_dump()
+{
+	return s_heap_policy.dump();
+}
+
+} // namespace common
+} // namespace allocator
+} // namespace arm
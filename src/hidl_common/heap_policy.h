@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2022 Arm Limited. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <string>
+
+#include "core/buffer_descriptor.h"
+
+namespace arm
+{
+namespace allocator
+{
+namespace common
+{
+
+/*
+ * Adaptive heap selection, enabled with vendor.gralloc.adaptive_heap.
+ *
+ * Many clients declare CPU_READ_RARELY, or no CPU read at all, and then lock their buffers
+ * for read every frame. Such buffers end up in CPU uncached memory, where reads are slow.
+ *
+ * The mappers count the CPU locks of every buffer in its shared metadata. The allocator keeps
+ * the shared metadata of the last few buffers of each (name, usage, format) mapped, until the
+ * buffers are freed by every process that imported them. When most
+ * of them turned out to be read often, later allocations of the same key are hinted to use
+ * CPU cached memory (buffer_descriptor_t::prefer_cpu_cached). The decision is revisited on
+ * every allocation, so the hint goes away again when the buffers stop being read.
+ */
+
+/*
+ * Sets descriptor->prefer_cpu_cached from what was observed of the earlier buffers of the
+ * same key.
+ */
+void heap_policy_apply(buffer_descriptor_t *descriptor);
+
+/*
+ * Starts observing the CPU locks of a newly allocated buffer, through its shared metadata
+ * mapped at attr_base. The policy takes over the mapping.
+ */
+void heap_policy_observe(const buffer_descriptor_t &descriptor, void *attr_base, size_t attr_size);
+
+/*
+ * Returns the learned policy, with the read lock counts of the observed buffers of each key,
+ * for the debug dump of the allocator service.
+ */
+std::string heap_policy_dump();
+
+} // namespace common
+} // namespace allocator
+} // namespace arm
@@ -17,6 +17,8 @@
  */
 
 #include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
 #include <sync/sync.h>
 #include "registered_handle_pool.h"
 #include "mapper.h"
@@ -24,6 +26,7 @@
 #include "core/buffer_allocation.h"
 #include "core/buffer_descriptor.h"
 #include "core/buffer_access.h"
+#include "core/runtime_config.h"
 #include "core/reference.h"
 #include "core/format_info.h"
 #include "allocator/allocator.h"
@@ -47,6 +50,9 @@
  * However, there is no way to make sure gralloc0/gralloc1 are valid. Any use
  * of static/global object in gralloc0/gralloc1 that may have been destructed
  * is potentially broken.
+ *
+ * Handles are validated once, when imported: a handle found in the pool needs no further
+ * private_handle_t::validate().
  */
 RegisteredHandlePool* gRegisteredHandles = new RegisteredHandlePool;
 
@@ -150,7 +156,7 @@ static hidl_handle getFenceHandle(int fenceFd, char* handleStorage)
 /*
  * Locks the given buffer for the specified CPU usage.
  *
- * @param bufferHandle [in]  Buffer to lock.
+ * @param bufferHandle [in]  Registered buffer to lock.
  * @param cpuUsage     [in]  Specifies one or more CPU usage flags to request
  * @param accessRegion [in]  Portion of the buffer that the client intends to access.
  * @param fenceFd      [in]  Fence file descriptor
@@ -179,16 +185,6 @@ static Error lockBuffer(buffer_handle_t bufferHandle,
 		}
 	}
 
-	if (private_handle_t::validate(bufferHandle) < 0)
-	{
-		if (fenceFd >= 0)
-		{
-			close(fenceFd);
-		}
-		MALI_GRALLOC_LOGE("Buffer: %p is corrupted", bufferHandle);
-		return Error::BAD_BUFFER;
-	}
-
 	auto private_handle = private_handle_t::downcast(bufferHandle);
 	const auto format = private_handle->get_alloc_format();
 	if (private_handle->cpu_write != 0 && (cpuUsage & BufferUsage::CPU_WRITE_MASK)
@@ -222,6 +218,15 @@ static Error lockBuffer(buffer_handle_t bufferHandle,
 		return result == -EINVAL ? Error::BAD_VALUE : Error::NO_RESOURCES;
 	}
 
+#if HIDL_MAPPER_VERSION_SCALED >= 400
+	/* Observed by the allocator to pick the heap of later buffers, see heap_policy.h. */
+	if (get_runtime_config().adaptive_heap() && private_handle->attr_base != MAP_FAILED)
+	{
+		mapper::common::record_cpu_lock(private_handle, (cpuUsage & BufferUsage::CPU_READ_MASK) != 0,
+		                                (cpuUsage & BufferUsage::CPU_WRITE_MASK) != 0);
+	}
+#endif
+
 	*outData = data;
 	return Error::NONE;
 }
@@ -229,7 +234,7 @@ static Error lockBuffer(buffer_handle_t bufferHandle,
 /*
  * Unlocks a buffer to indicate all CPU accesses to the buffer have completed
  *
- * @param bufferHandle [in]  Buffer to lock.
+ * @param bufferHandle [in]  Registered buffer to unlock.
  * @param outFenceFd   [out] Fence file descriptor
  *
  * @return Error::BAD_BUFFER for an invalid buffer
@@ -239,12 +244,6 @@ static Error lockBuffer(buffer_handle_t bufferHandle,
 static Error unlockBuffer(buffer_handle_t bufferHandle,
                                   int* outFenceFd)
 {
-	if (private_handle_t::validate(bufferHandle) < 0)
-	{
-		MALI_GRALLOC_LOGE("Buffer: %p is corrupted", bufferHandle);
-		return Error::BAD_BUFFER;
-	}
-
 	auto private_handle = private_handle_t::downcast(bufferHandle);
 	if (private_handle->lock_count == 0)
 	{
@@ -264,6 +263,45 @@ static Error unlockBuffer(buffer_handle_t bufferHandle,
 	return Error::NONE;
 }
 
+/*
+ * Clones a handle being imported. Handles allocated by earlier gralloc releases lack the CPU
+ * lock state at the end of private_handle_t: they are cloned into a handle of the current size,
+ * with the lock state cleared.
+ */
+static native_handle_t *clone_buffer_handle(const native_handle_t *rawHandle)
+{
+	const auto *hnd = reinterpret_cast<const private_handle_t *>(rawHandle);
+	if (rawHandle->version != sizeof(native_handle_t) || rawHandle->numFds != PRIVATE_HANDLE_NUM_FDS ||
+	    rawHandle->numInts != static_cast<int>(PRIVATE_HANDLE_LEGACY_NUM_INTS) || hnd->magic != private_handle_t::sMagic)
+	{
+		return native_handle_clone(rawHandle);
+	}
+
+	native_handle_t *clone = native_handle_create(PRIVATE_HANDLE_NUM_FDS, PRIVATE_HANDLE_NUM_INTS);
+	if (clone == nullptr)
+	{
+		return nullptr;
+	}
+
+	for (int i = 0; i < PRIVATE_HANDLE_NUM_FDS; i++)
+	{
+		clone->data[i] = dup(rawHandle->data[i]);
+		if (clone->data[i] < 0)
+		{
+			clone->numFds = i;
+			native_handle_close(clone);
+			native_handle_delete(clone);
+			return nullptr;
+		}
+	}
+
+	int *ints = &clone->data[PRIVATE_HANDLE_NUM_FDS];
+	memcpy(ints, &rawHandle->data[PRIVATE_HANDLE_NUM_FDS], PRIVATE_HANDLE_LEGACY_NUM_INTS * sizeof(int));
+	memset(ints + PRIVATE_HANDLE_LEGACY_NUM_INTS, 0,
+	       (PRIVATE_HANDLE_NUM_INTS - PRIVATE_HANDLE_LEGACY_NUM_INTS) * sizeof(int));
+	return clone;
+}
+
 void importBuffer(const hidl_handle& rawHandle, IMapper::importBuffer_cb hidl_cb)
 {
 	if (!rawHandle.getNativeHandle())
@@ -273,7 +311,7 @@ void importBuffer(const hidl_handle& rawHandle, IMapper::importBuffer_cb hidl_cb
 		return;
 	}
 
-	native_handle_t* bufferHandle = native_handle_clone(rawHandle.getNativeHandle());
+	native_handle_t* bufferHandle = clone_buffer_handle(rawHandle.getNativeHandle());
 	if (!bufferHandle)
 	{
 		MALI_GRALLOC_LOGE("Failed to clone buffer handle");
@@ -292,14 +330,12 @@ void importBuffer(const hidl_handle& rawHandle, IMapper::importBuffer_cb hidl_cb
 	}
 
 #if HIDL_MAPPER_VERSION_SCALED >= 400
-	auto *private_handle = static_cast<private_handle_t *>(bufferHandle);
-	private_handle->attr_base = mmap(nullptr, private_handle->attr_size, PROT_READ | PROT_WRITE,
-	                                 MAP_SHARED, private_handle->share_attr_fd, 0);
-	if (private_handle->attr_base == MAP_FAILED)
+	const int ret = import_shared_metadata(static_cast<private_handle_t *>(bufferHandle));
+	if (ret < 0)
 	{
 		native_handle_close(bufferHandle);
 		native_handle_delete(bufferHandle);
-		hidl_cb(Error::NO_RESOURCES, nullptr);
+		hidl_cb(ret == -EINVAL ? Error::BAD_BUFFER : Error::NO_RESOURCES, nullptr);
 		return;
 	}
 #endif
@@ -311,6 +347,9 @@ void importBuffer(const hidl_handle& rawHandle, IMapper::importBuffer_cb hidl_cb
 		 */
 		MALI_GRALLOC_LOGE("Handle %p has already been imported; potential fd leaking",
 		       bufferHandle);
+#if HIDL_MAPPER_VERSION_SCALED >= 400
+		release_shared_metadata(static_cast<private_handle_t *>(bufferHandle));
+#endif
 		unregisterBuffer(bufferHandle);
 		native_handle_close(bufferHandle);
 		native_handle_delete(bufferHandle);
@@ -332,15 +371,7 @@ Error freeBuffer(void* buffer)
 	}
 
 #if HIDL_MAPPER_VERSION_SCALED >= 400
-	{
-		auto *private_handle = static_cast<private_handle_t *>(bufferHandle);
-		int ret = munmap(private_handle->attr_base, private_handle->attr_size);
-		if (ret < 0)
-		{
-			MALI_GRALLOC_LOGW("munmap: %s", strerror(errno));
-		}
-		private_handle->attr_base = MAP_FAILED;
-	}
+	release_shared_metadata(static_cast<private_handle_t *>(bufferHandle));
 #endif
 	const Error status = unregisterBuffer(bufferHandle);
 	if (status != Error::NONE)
@@ -358,9 +389,9 @@ void lock(void* buffer, uint64_t cpuUsage, const IMapper::Rect& accessRegion,
           const hidl_handle& acquireFence, IMapper::lock_cb hidl_cb)
 {
 	buffer_handle_t bufferHandle = gRegisteredHandles->get(buffer);
-	if (!bufferHandle || private_handle_t::validate(bufferHandle) < 0)
+	if (!bufferHandle)
 	{
-		MALI_GRALLOC_LOGE("Buffer to lock: %p is not valid", buffer);
+		MALI_GRALLOC_LOGE("Buffer to lock: %p has not been registered with Gralloc", buffer);
 #if HIDL_MAPPER_VERSION_SCALED >= 300 && HIDL_MAPPER_VERSION_SCALED < 400
 		hidl_cb(Error::BAD_BUFFER, nullptr, -1, -1);
 #else
@@ -458,7 +489,7 @@ void unlock(void* buffer, IMapper::unlock_cb hidl_cb)
  * Locks the given buffer for the specified CPU usage and exports cpu accessible
  * data in YCbCr structure.
  *
- * @param bufferHandle [in]  Buffer to lock.
+ * @param bufferHandle [in]  Registered buffer to lock.
  * @param cpuUsage     [in]  Specifies one or more CPU usage flags to request
  * @param accessRegion [in]  Portion of the buffer that the client intends to access.
  * @param fenceFd      [in]  Fence file descriptor
@@ -477,12 +508,6 @@ static Error lockBuffer(buffer_handle_t bufferHandle,
 	int result;
 	android_ycbcr ycbcr = {};
 
-	if (private_handle_t::validate(bufferHandle) < 0)
-	{
-		MALI_GRALLOC_LOGE("Buffer: %p is corrupted", bufferHandle);
-		return Error::BAD_BUFFER;
-	}
-
 	if (fenceFd >= 0)
 	{
 		fenceFd = dup(fenceFd);
@@ -646,12 +671,6 @@ void getTransportSize(void* buffer, IMapper::getTransportSize_cb hidl_cb)
 		return;
 	}
 
-	if (private_handle_t::validate(bufferHandle) < 0)
-	{
-		MALI_GRALLOC_LOGE("Buffer %p is corrupted", buffer);
-		hidl_cb(Error::BAD_BUFFER, -1, -1);
-		return;
-	}
 	hidl_cb(Error::NONE, bufferHandle->numFds, bufferHandle->numInts);
 }
 #endif /* HIDL_MAPPER_VERSION_SCALED >= 210 */
@@ -681,9 +700,9 @@ void isSupported(const IMapper::BufferDescriptorInfo& description, IMapper::isSu
 void flushLockedBuffer(void *buffer, IMapper::flushLockedBuffer_cb hidl_cb)
 {
 	buffer_handle_t handle = gRegisteredHandles->get(buffer);
-	if (private_handle_t::validate(handle) < 0)
+	if (handle == nullptr)
 	{
-		MALI_GRALLOC_LOGE("Bandle: %p is corrupted", handle);
+		MALI_GRALLOC_LOGE("Buffer: %p has not been registered with Gralloc", buffer);
 		hidl_cb(Error::BAD_BUFFER, hidl_handle{});
 		return;
 	}
@@ -703,9 +722,9 @@ void flushLockedBuffer(void *buffer, IMapper::flushLockedBuffer_cb hidl_cb)
 Error rereadLockedBuffer(void *buffer)
 {
 	buffer_handle_t handle = gRegisteredHandles->get(buffer);
-	if (private_handle_t::validate(handle) < 0)
+	if (handle == nullptr)
 	{
-		MALI_GRALLOC_LOGE("Buffer: %p is corrupted", handle);
+		MALI_GRALLOC_LOGE("Buffer: %p has not been registered with Gralloc", buffer);
 		return Error::BAD_BUFFER;
 	}
 
@@ -775,6 +794,8 @@ void listSupportedMetadataTypes(IMapper::listSupportedMetadataTypes_cb hidl_cb)
 		/* Arm vendor metadata */
 		{ ArmMetadataType_PLANE_FDS,
 			"Vector of file descriptors of each plane", true, false },
+		{ ArmMetadataType_METADATA_GENERATION,
+			"Generation of the shared metadata, incremented by every update", true, false },
 	};
 	hidl_cb(Error::NONE, descriptions);
 	return;
@@ -865,8 +886,13 @@ void getReservedRegion(void *buffer, IMapper::getReservedRegion_cb hidl_cb)
 		hidl_cb(Error::BAD_BUFFER, 0, 0);
 		return;
 	}
-	void *reserved_region = static_cast<std::byte *>(handle->attr_base)
-	    + mapper::common::shared_metadata_size();
+	void *reserved_region = mapper::common::get_reserved_region(handle);
+	if (reserved_region == nullptr)
+	{
+		MALI_GRALLOC_LOGE("Buffer: %p has a reserved region out of its shared metadata", buffer);
+		hidl_cb(Error::BAD_BUFFER, 0, 0);
+		return;
+	}
 	hidl_cb(Error::NONE, reserved_region, handle->reserved_region_size);
 }
 
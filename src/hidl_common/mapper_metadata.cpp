@@ -534,6 +534,20 @@ void get_metadata(const private_handle_t *handle, const IMapper::MetadataType &m
 			}
 			break;
 		}
+		case ArmMetadataType::METADATA_GENERATION:
+		{
+			uint32_t generation;
+			if (!get_metadata_generation(handle, &generation))
+			{
+				err = android::BAD_VALUE;
+				break;
+			}
+
+			const int64_t value = generation;
+			vec.resize(sizeof(value));
+			memcpy(vec.data(), &value, sizeof(value));
+			break;
+		}
 		default:
 			err = android::BAD_VALUE;
 		}
@@ -47,6 +47,8 @@ const static ExtendableType Compression_AFRC{ GRALLOC_ARM_COMPRESSION_TYPE_NAME,
 #define GRALLOC_ARM_METADATA_TYPE_NAME "arm.graphics.ArmMetadataType"
 const static IMapper::MetadataType ArmMetadataType_PLANE_FDS{ GRALLOC_ARM_METADATA_TYPE_NAME,
                                                   static_cast<int64_t>(aidl::arm::graphics::ArmMetadataType::PLANE_FDS) };
+const static IMapper::MetadataType ArmMetadataType_METADATA_GENERATION{ GRALLOC_ARM_METADATA_TYPE_NAME,
+                                                  static_cast<int64_t>(aidl::arm::graphics::ArmMetadataType::METADATA_GENERATION) };
 
 #define GRALLOC_ARM_CHROMA_SITING_TYPE_NAME "arm.graphics.ChromaSiting"
 const static ExtendableType ChromaSiting_CositedVertical{ GRALLOC_ARM_CHROMA_SITING_TYPE_NAME,
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2020 ARM Limited. All rights reserved.
+ * Copyright (C) 2020, 2022 ARM Limited. All rights reserved.
  *
  * Copyright 2016 The Android Open Source Project
  *
@@ -16,32 +16,296 @@
  * limitations under the License.
  */
 
+#include <algorithm>
+#include <stdint.h>
+
 #include "registered_handle_pool.h"
 
+/* Capacity of the tables of a new pool; each shard grows on its own. */
+static constexpr size_t initial_capacity = 16;
+
+/* Marks the slot of a removed handle, which lookups probe past. */
+static const buffer_handle_t tombstone = reinterpret_cast<buffer_handle_t>(uintptr_t{1});
+
+/*
+ * Epoch based reclamation of the retired tables.
+ *
+ * Each thread doing lookups owns a record, in which it announces the global epoch while it
+ * probes a table, and 0 otherwise. Publishing a table and then advancing the epoch means that
+ * a lookup announcing the new epoch, or a later one, can only find the new table. Tables
+ * retired at epoch E are freed once no record announces an epoch below E.
+ *
+ * Announcing is a store to a cache line of the thread's own, so lookups from different
+ * threads do not contend. Records of exited threads are reused; none is ever freed.
+ */
+struct alignas(64) reader_record
+{
+	std::atomic<uint64_t> epoch{0};
+	std::atomic<bool> in_use{false};
+	reader_record *next{nullptr};
+};
+
+static std::atomic<uint64_t> s_epoch{1};
+static std::atomic<reader_record *> s_readers{nullptr};
+
+class reader_registration
+{
+public:
+	reader_registration()
+	{
+		for (reader_record *r = s_readers.load(std::memory_order_acquire); r != nullptr; r = r->next)
+		{
+			bool expected = false;
+			if (r->in_use.compare_exchange_strong(expected, true, std::memory_order_acquire))
+			{
+				record = r;
+				return;
+			}
+		}
+
+		record = new reader_record;
+		record->in_use.store(true, std::memory_order_relaxed);
+		record->next = s_readers.load(std::memory_order_relaxed);
+		while (!s_readers.compare_exchange_weak(record->next, record, std::memory_order_release,
+		                                        std::memory_order_relaxed))
+		{
+		}
+	}
+
+	~reader_registration()
+	{
+		record->epoch.store(0, std::memory_order_release);
+		record->in_use.store(false, std::memory_order_release);
+	}
+
+	reader_record *record;
+};
+
+/* Lookups of the calling thread in the scope of this object may probe any published table. */
+class read_section
+{
+public:
+	read_section()
+		: record(t_registration.record)
+	{
+		record->epoch.store(s_epoch.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+	}
+
+	~read_section()
+	{
+		record->epoch.store(0, std::memory_order_release);
+	}
+
+private:
+	static thread_local reader_registration t_registration;
+	reader_record *record;
+};
+
+thread_local reader_registration read_section::t_registration;
+
+/* The oldest epoch a lookup in progress may have announced. */
+static uint64_t get_oldest_read_epoch()
+{
+	uint64_t oldest = UINT64_MAX;
+	for (reader_record *r = s_readers.load(std::memory_order_acquire); r != nullptr; r = r->next)
+	{
+		const uint64_t epoch = r->epoch.load(std::memory_order_seq_cst);
+		if (epoch != 0 && epoch < oldest)
+		{
+			oldest = epoch;
+		}
+	}
+	return oldest;
+}
+
+/* Handles come from malloc(): drop the always clear low bits, then mix. */
+static uint64_t hash(const void *handle)
+{
+	return (static_cast<uint64_t>(reinterpret_cast<uintptr_t>(handle)) >> 4) * UINT64_C(0x9E3779B97F4A7C15);
+}
+
+/* The top bits of the hash pick the shard, lower bits the first slot probed. */
+static size_t first_slot(buffer_handle_t bufferHandle, size_t capacity)
+{
+	return static_cast<size_t>(hash(bufferHandle) >> 32) & (capacity - 1);
+}
+
+static bool contains(const std::atomic<buffer_handle_t> *slots, size_t capacity, buffer_handle_t bufferHandle)
+{
+	for (size_t i = first_slot(bufferHandle, capacity);; i = (i + 1) & (capacity - 1))
+	{
+		const buffer_handle_t slot = slots[i].load(std::memory_order_acquire);
+		if (slot == bufferHandle)
+		{
+			return true;
+		}
+		else if (slot == nullptr)
+		{
+			return false;
+		}
+	}
+}
+
+RegisteredHandlePool::table::table(size_t capacity)
+	: capacity(capacity)
+	, slots(new std::atomic<buffer_handle_t>[capacity])
+{
+	for (size_t i = 0; i < capacity; i++)
+	{
+		slots[i].store(nullptr, std::memory_order_relaxed);
+	}
+}
+
+RegisteredHandlePool::RegisteredHandlePool()
+{
+	for (auto &s : shards)
+	{
+		rehash(s, initial_capacity);
+	}
+}
+
+RegisteredHandlePool::shard &RegisteredHandlePool::get_shard(buffer_handle_t bufferHandle)
+{
+	static_assert((num_shards & (num_shards - 1)) == 0, "num_shards must be a power of two");
+	return shards[hash(bufferHandle) >> 60 & (num_shards - 1)];
+}
+
+/*
+ * Publishes a copy of the live handles of the shard in a new table, and frees the retired
+ * tables no lookup can be probing anymore. Called with the shard mutex held.
+ */
+void RegisteredHandlePool::rehash(shard &s, size_t capacity)
+{
+	auto fresh = std::make_unique<table>(capacity);
+	table *old = s.owned.get();
+	if (old != nullptr)
+	{
+		for (size_t i = 0; i < old->capacity; i++)
+		{
+			const buffer_handle_t handle = old->slots[i].load(std::memory_order_relaxed);
+			if (handle == nullptr || handle == tombstone)
+			{
+				continue;
+			}
+
+			size_t j = first_slot(handle, capacity);
+			while (fresh->slots[j].load(std::memory_order_relaxed) != nullptr)
+			{
+				j = (j + 1) & (capacity - 1);
+			}
+			fresh->slots[j].store(handle, std::memory_order_relaxed);
+		}
+	}
+
+	s.current.store(fresh.get(), std::memory_order_seq_cst);
+	s.used = s.live;
+	if (old != nullptr)
+	{
+		s.retired.emplace_back(s_epoch.fetch_add(1, std::memory_order_seq_cst) + 1, std::move(s.owned));
+	}
+	s.owned = std::move(fresh);
+
+	const uint64_t oldest = get_oldest_read_epoch();
+	auto last = std::remove_if(s.retired.begin(), s.retired.end(),
+	                           [oldest](const auto &retired) { return retired.first <= oldest; });
+	s.retired.erase(last, s.retired.end());
+}
+
 bool RegisteredHandlePool::add(buffer_handle_t bufferHandle)
 {
-    std::lock_guard<std::mutex> lock(mutex);
-    return bufPool.insert(bufferHandle).second;
+	shard &s = get_shard(bufferHandle);
+	std::lock_guard<std::mutex> lock(s.mutex);
+
+	table *t = s.owned.get();
+	const size_t mask = t->capacity - 1;
+	size_t free_slot = SIZE_MAX;
+	for (size_t i = first_slot(bufferHandle, t->capacity);; i = (i + 1) & mask)
+	{
+		const buffer_handle_t slot = t->slots[i].load(std::memory_order_relaxed);
+		if (slot == bufferHandle)
+		{
+			return false;
+		}
+		else if (slot == tombstone && free_slot == SIZE_MAX)
+		{
+			free_slot = i;
+		}
+		else if (slot == nullptr)
+		{
+			if (free_slot == SIZE_MAX)
+			{
+				free_slot = i;
+				s.used++;
+			}
+			break;
+		}
+	}
+
+	t->slots[free_slot].store(bufferHandle, std::memory_order_release);
+	s.live++;
+
+	/* Keep a free slot to end every probe: grow when half full, or clear the tombstones. */
+	if (s.used * 4 > t->capacity * 3)
+	{
+		rehash(s, s.live * 2 > t->capacity ? t->capacity * 2 : t->capacity);
+	}
+
+	return true;
 }
 
 native_handle_t* RegisteredHandlePool::remove(void* buffer)
 {
-    auto bufferHandle = static_cast<native_handle_t*>(buffer);
+	auto bufferHandle = static_cast<native_handle_t*>(buffer);
+
+	std::shared_lock<std::shared_mutex> remove_lock(remove_mutex);
+	shard &s = get_shard(bufferHandle);
+	std::lock_guard<std::mutex> lock(s.mutex);
 
-    std::lock_guard<std::mutex> lock(mutex);
-    return bufPool.erase(bufferHandle) == 1 ? bufferHandle : nullptr;
+	table *t = s.owned.get();
+	for (size_t i = first_slot(bufferHandle, t->capacity);; i = (i + 1) & (t->capacity - 1))
+	{
+		const buffer_handle_t slot = t->slots[i].load(std::memory_order_relaxed);
+		if (slot == bufferHandle)
+		{
+			t->slots[i].store(tombstone, std::memory_order_release);
+			s.live--;
+			return bufferHandle;
+		}
+		else if (slot == nullptr)
+		{
+			return nullptr;
+		}
+	}
 }
 
 buffer_handle_t RegisteredHandlePool::get(const void* buffer)
 {
-    auto bufferHandle = static_cast<buffer_handle_t>(buffer);
+	auto bufferHandle = static_cast<buffer_handle_t>(buffer);
+	const shard &s = get_shard(bufferHandle);
 
-    std::lock_guard<std::mutex> lock(mutex);
-    return bufPool.count(bufferHandle) == 1 ? bufferHandle : nullptr;
+	read_section section;
+	const table *t = s.current.load(std::memory_order_seq_cst);
+	return contains(t->slots.get(), t->capacity, bufferHandle) ? bufferHandle : nullptr;
 }
 
 void RegisteredHandlePool::for_each(std::function<void(const buffer_handle_t &)> fn)
 {
-    std::lock_guard<std::mutex> lock(mutex);
-    std::for_each(bufPool.begin(), bufPool.end(), fn);
-}
\ No newline at end of file
+	std::unique_lock<std::shared_mutex> remove_lock(remove_mutex);
+
+	std::vector<buffer_handle_t> snapshot;
+	for (const auto &s : shards)
+	{
+		read_section section;
+		const table *t = s.current.load(std::memory_order_seq_cst);
+		for (size_t i = 0; i < t->capacity; i++)
+		{
+			const buffer_handle_t handle = t->slots[i].load(std::memory_order_acquire);
+			if (handle != nullptr && handle != tombstone)
+			{
+				snapshot.push_back(handle);
+			}
+		}
+	}
+
+	std::for_each(snapshot.begin(), snapshot.end(), fn);
+}
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2020 ARM Limited. All rights reserved.
+ * Copyright (C) 2020, 2022 ARM Limited. All rights reserved.
  *
  * Copyright 2016 The Android Open Source Project
  *
@@ -18,15 +18,32 @@
 #pragma once
 
 #include <cutils/native_handle.h>
+#include <array>
+#include <atomic>
+#include <memory>
 #include <mutex>
-#include <unordered_set>
-#include <algorithm>
+#include <shared_mutex>
+#include <utility>
+#include <vector>
 #include <functional>
 
-/* An unordered set to internally store / retrieve imported buffer handles */
+/*
+ * A concurrent set to internally store / retrieve imported buffer handles.
+ *
+ * Every mapper call looks its buffer up here, from many threads at once, so lookups take no
+ * lock: handles are spread over shards, each an open addressing table of atomic slots that
+ * lookups probe with atomic loads. Adds and removes lock their shard only.
+ *
+ * A shard outgrowing its table, or filling up with tombstones of removed handles, publishes
+ * a fresh copy. Lookups may still be probing the old table, so it is retired, and freed once
+ * every thread has left the lookups started before the copy was published (epoch based
+ * reclamation, see registered_handle_pool.cpp).
+ */
 class RegisteredHandlePool
 {
 public:
+	RegisteredHandlePool();
+
 	/* Stores the buffer handle in the internal list */
 	bool add(buffer_handle_t bufferHandle);
 
@@ -36,10 +53,41 @@ public:
 	/* Retrieves the buffer handle from internal list */
 	buffer_handle_t get(const void* buffer);
 
-	/* Applies a function to each buffer handle */
+	/*
+	 * Applies a function to each buffer handle, from a snapshot of the set. Imports and lookups
+	 * go on meanwhile; removes, after which the buffer is freed, wait until it returns.
+	 */
 	void for_each(std::function<void(const buffer_handle_t &)> fn);
 
 private:
-	std::mutex mutex;
-	std::unordered_set<buffer_handle_t> bufPool;
+	struct table
+	{
+		explicit table(size_t capacity);
+
+		/* Power of two. */
+		const size_t capacity;
+		const std::unique_ptr<std::atomic<buffer_handle_t>[]> slots;
+	};
+
+	struct alignas(64) shard
+	{
+		std::mutex mutex;
+		std::atomic<table *> current{};
+		/* Slots of the current table holding a handle, and holding a handle or a tombstone. */
+		size_t live{};
+		size_t used{};
+		std::unique_ptr<table> owned;
+		/* Replaced tables, with the epoch after which no lookup can be probing them. */
+		std::vector<std::pair<uint64_t, std::unique_ptr<table>>> retired;
+	};
+
+	static constexpr size_t num_shards = 16;
+
+	shard &get_shard(buffer_handle_t bufferHandle);
+	static void rehash(shard &s, size_t capacity);
+
+	std::array<shard, num_shards> shards;
+
+	/* Held shared by removes, and exclusively by for_each(). */
+	std::shared_mutex remove_mutex;
 };
@@ -16,6 +16,15 @@
  * limitations under the License.
  */
 
+#include <atomic>
+#include <inttypes.h>
+#include <mutex>
+#include <string.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+
 #include "shared_metadata.h"
 #include "mapper_metadata.h"
 #include "log.h"
@@ -64,9 +73,102 @@ struct aligned_optional
 		case state::vacant: return std::nullopt;
 		case state::occupied: return std::make_optional(item);
 		}
+		return std::nullopt;
 	}
 };
 
+/*
+ * Version of the layout of the shared metadata, checked when a buffer is imported. Buffers
+ * allocated by earlier gralloc releases have the legacy layout, without the header; they are
+ * told apart by the size of their region (see is_legacy_layout()).
+ */
+#define SHARED_METADATA_VERSION 2
+
+/* Retries after which a reader or a writer assumes the seqlock was left odd by a dead writer. */
+#define SHARED_METADATA_MAX_RETRIES 100000
+
+/* Longest buffer name kept in the shared metadata. */
+#define SHARED_METADATA_MAX_NAME 256
+
+/* Room for the SMPTE 2094-40 dynamic HDR metadata of a buffer. */
+#define SHARED_METADATA_SMPTE2094_40_CAPACITY 2048
+
+/*
+ * Header of the shared metadata.
+ *
+ * The metadata is written by producers and read by consumers in other processes, through their
+ * own mappings. 'sequence' is a seqlock: a writer makes it odd while it updates the metadata,
+ * with a compare-and-swap so that writers exclude each other, and even again once done. Readers
+ * copy what they need and retry if the sequence was odd or has changed meanwhile, so that they
+ * never see a half written crop rectangle or HDR blob. Neither takes a lock.
+ *
+ * Every update advances the sequence by 2, so half of it counts the updates of the metadata.
+ */
+struct shared_metadata_header
+{
+	uint32_t version { SHARED_METADATA_VERSION };
+	std::atomic<uint32_t> sequence { 0 };
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "the seqlock must work across processes");
+
+/* Variable sized item of the shared metadata, at 'offset' from its start. */
+struct blob_ref
+{
+	uint64_t offset;
+	uint32_t size;
+	uint32_t capacity;
+};
+
+/*
+ * Layout of the shared metadata.
+ *
+ * The fields read for every composition come first, in the same cache line as the seqlock.
+ * The name and the SMPTE 2094-40 metadata follow the fixed fields in the same memfd:
+ *
+ *   | shared_metadata | name | reserved region | ... | SMPTE 2094-40 |
+ *
+ * The name takes its own length only. The SMPTE 2094-40 area is on a page of its own unless it
+ * fits in the last page of the reserved region. The memfd only gets pages once written, so
+ * buffers that never carry dynamic HDR metadata do not pay for it.
+ */
+struct shared_metadata
+{
+	shared_metadata_header header {};
+	aligned_optional<int64_t> chroma_siting {};
+	aligned_optional<Rect> crop {};
+	aligned_optional<Dataspace> dataspace {};
+	aligned_optional<BlendMode> blend_mode {};
+	uint32_t reserved_offset {};
+	aligned_optional<Cta861_3> cta861_3 {};
+	aligned_optional<Smpte2086> smpte2086 {};
+	std::atomic<uint32_t> cpu_read_locks {};
+	std::atomic<uint32_t> cpu_write_locks {};
+	blob_ref name {};
+	blob_ref smpte2094_40 {};
+	std::atomic<uint32_t> imports {};
+	std::atomic<uint32_t> releases {};
+};
+
+static_assert(offsetof(shared_metadata, header) == 0, "bad alignment");
+static_assert(offsetof(shared_metadata, chroma_siting) == 8, "bad alignment");
+static_assert(offsetof(shared_metadata, crop) == 24, "bad alignment");
+static_assert(offsetof(shared_metadata, dataspace) == 44, "bad alignment");
+static_assert(offsetof(shared_metadata, blend_mode) == 52, "bad alignment");
+static_assert(offsetof(shared_metadata, reserved_offset) == 60, "bad alignment");
+static_assert(offsetof(shared_metadata, cta861_3) == 64, "bad alignment");
+static_assert(offsetof(shared_metadata, smpte2086) == 76, "bad alignment");
+static_assert(offsetof(shared_metadata, cpu_read_locks) == 120, "bad alignment");
+static_assert(offsetof(shared_metadata, cpu_write_locks) == 124, "bad alignment");
+static_assert(offsetof(shared_metadata, name) == 128, "bad alignment");
+static_assert(offsetof(shared_metadata, smpte2094_40) == 144, "bad alignment");
+static_assert(offsetof(shared_metadata, imports) == 160, "bad alignment");
+static_assert(offsetof(shared_metadata, releases) == 164, "bad alignment");
+static_assert(sizeof(blob_ref) == 16, "bad size");
+
+static_assert(alignof(shared_metadata) == 8, "bad alignment");
+static_assert(sizeof(shared_metadata) == 168, "bad size");
+
 template <typename T, size_t N>
 struct aligned_inline_vector
 {
@@ -89,87 +191,493 @@ struct aligned_inline_vector
 	}
 };
 
-struct shared_metadata
+/*
+ * Layout of the shared metadata of the buffers allocated by earlier gralloc releases, with the
+ * blobs inline and no header. Its region holds the metadata, then the reserved region, so it is
+ * recognised by its size. It is read and written as those releases did, without a seqlock, and
+ * has no room for the CPU lock and import counts.
+ */
+struct legacy_shared_metadata
 {
 	aligned_optional<BlendMode> blend_mode {};
 	aligned_optional<Rect> crop {};
 	aligned_optional<Cta861_3> cta861_3 {};
 	aligned_optional<Dataspace> dataspace {};
-	/* Store only the value from the ExtendableType as the string in this type is not a fixed size */
 	aligned_optional<int64_t> chroma_siting {};
 	aligned_optional<Smpte2086> smpte2086 {};
 	aligned_inline_vector<uint8_t, 2048> smpte2094_40 {};
 	aligned_inline_vector<char, 256> name {};
+};
+
+static_assert(offsetof(legacy_shared_metadata, blend_mode) == 0, "bad alignment");
+static_assert(offsetof(legacy_shared_metadata, crop) == 8, "bad alignment");
+static_assert(offsetof(legacy_shared_metadata, cta861_3) == 28, "bad alignment");
+static_assert(offsetof(legacy_shared_metadata, dataspace) == 40, "bad alignment");
+static_assert(offsetof(legacy_shared_metadata, chroma_siting) == 48, "bad alignment");
+static_assert(offsetof(legacy_shared_metadata, smpte2086) == 64, "bad alignment");
+static_assert(offsetof(legacy_shared_metadata, smpte2094_40) == 108, "bad alignment");
+static_assert(offsetof(legacy_shared_metadata, name) == 2160, "bad alignment");
+static_assert(alignof(legacy_shared_metadata) == 8, "bad alignment");
+static_assert(sizeof(legacy_shared_metadata) == 2424, "bad size");
+
+/*
+ * Whether the buffer has the legacy layout. Decided from the size of the region in the handle,
+ * which shared_metadata_size() never gives to the current layout, rather than from the shared
+ * memory, which any process mapping it can rewrite. Both layouts fit in such a region.
+ */
+static bool is_legacy_layout(const private_handle_t *hnd)
+{
+	return hnd->attr_size == sizeof(legacy_shared_metadata) + hnd->reserved_region_size;
+}
+
+/*
+ * Calls 'fn' with the metadata mapped at 'memory', in the current layout. Its version was
+ * checked when the buffer was imported and is never read again: any process mapping the
+ * metadata can rewrite it.
+ */
+template <typename F>
+static auto visit_metadata(void *memory, F &&fn)
+{
+	return fn(*static_cast<shared_metadata *>(memory));
+}
+
+/* Calls 'fn' with the metadata of the buffer, in its layout. */
+template <typename F>
+static auto visit_metadata(const private_handle_t *hnd, F &&fn)
+{
+	if (is_legacy_layout(hnd))
+	{
+		return fn(*static_cast<legacy_shared_metadata *>(hnd->attr_base));
+	}
+	return fn(*static_cast<shared_metadata *>(hnd->attr_base));
+}
+
+/*
+ * Updates the metadata of the buffer under its seqlock. Readers may observe the metadata while
+ * 'update' runs, so it must be given validated values only.
+ */
+template <typename F>
+static void write_metadata(const private_handle_t *hnd, F &&update)
+{
+	if (is_legacy_layout(hnd))
+	{
+		visit_metadata(hnd, update);
+		return;
+	}
+
+	auto *header = static_cast<shared_metadata_header *>(hnd->attr_base);
+	auto &sequence = header->sequence;
+
+	uint32_t begin = sequence.load(std::memory_order_relaxed);
+	for (int retries = 0;; retries++)
+	{
+		if ((begin & 1) && retries < SHARED_METADATA_MAX_RETRIES)
+		{
+			std::this_thread::yield();
+			begin = sequence.load(std::memory_order_relaxed);
+		}
+		else if (sequence.compare_exchange_weak(begin, (begin | 1), std::memory_order_acquire,
+		                                        std::memory_order_relaxed))
+		{
+			if (begin & 1)
+			{
+				MALI_GRALLOC_LOGW("Taking over the shared metadata of buffer %p from a stalled writer", hnd);
+			}
+			break;
+		}
+	}
 
-	shared_metadata() = default;
+	/* The metadata stores must not be seen before the sequence is odd. */
+	std::atomic_thread_fence(std::memory_order_release);
+	visit_metadata(hnd, update);
+	sequence.store((begin | 1) + 1, std::memory_order_release);
+}
 
-	shared_metadata(std::string_view in_name)
+/*
+ * Returns what 'read' copies out of the metadata of the buffer, consistent with a single
+ * generation of the metadata. 'read' may run several times and see torn values: it must only
+ * copy them, and only the copy returned by read_metadata() may be interpreted.
+ */
+template <typename F>
+static auto read_metadata(const private_handle_t *hnd, F &&read)
+{
+	if (is_legacy_layout(hnd))
 	{
-		name.size = std::min(name.capacity(), static_cast<uint32_t>(in_name.size()));
-		std::memcpy(name.data(), in_name.data(), name.size);
+		return visit_metadata(hnd, read);
 	}
 
-	std::string_view get_name() const
+	const auto *header = static_cast<const shared_metadata_header *>(hnd->attr_base);
+	const auto &sequence = header->sequence;
+
+	for (int retries = 0;; retries++)
+	{
+		const uint32_t begin = sequence.load(std::memory_order_acquire);
+		if ((begin & 1) && retries < SHARED_METADATA_MAX_RETRIES)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		auto value = visit_metadata(hnd, read);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (sequence.load(std::memory_order_relaxed) == begin || retries >= SHARED_METADATA_MAX_RETRIES)
+		{
+			return value;
+		}
+	}
+}
+
+/*
+ * Returns the item referenced by 'ref', or nullptr when the reference, which any process
+ * mapping the metadata may write, points outside of the region of the buffer.
+ */
+static uint8_t *get_blob(const private_handle_t *hnd, const blob_ref &ref)
+{
+	if (ref.offset < sizeof(shared_metadata) || ref.offset > hnd->attr_size ||
+	    ref.capacity > hnd->attr_size - ref.offset)
+	{
+		return nullptr;
+	}
+	return static_cast<uint8_t *>(hnd->attr_base) + ref.offset;
+}
+
+static std::string copy_name(const private_handle_t *hnd, const shared_metadata &metadata)
+{
+	const blob_ref ref = metadata.name;
+	const auto *name = reinterpret_cast<const char *>(get_blob(hnd, ref));
+	return name != nullptr ? std::string(name, std::min(ref.size, ref.capacity)) : std::string();
+}
+
+static std::vector<uint8_t> copy_smpte2094_40(const private_handle_t *hnd, const shared_metadata &metadata)
+{
+	const blob_ref ref = metadata.smpte2094_40;
+	const uint8_t *begin = get_blob(hnd, ref);
+	return begin != nullptr ? std::vector<uint8_t>(begin, begin + std::min(ref.size, ref.capacity))
+	                        : std::vector<uint8_t>();
+}
+
+static bool store_smpte2094_40(const private_handle_t *hnd, shared_metadata &metadata,
+                               const std::vector<uint8_t> &smpte2094_40)
+{
+	const blob_ref ref = metadata.smpte2094_40;
+	uint8_t *data = get_blob(hnd, ref);
+	if (data == nullptr || smpte2094_40.size() > ref.capacity)
+	{
+		return false;
+	}
+	metadata.smpte2094_40.size = smpte2094_40.size();
+	std::memcpy(data, smpte2094_40.data(), smpte2094_40.size());
+	return true;
+}
+
+static uint64_t get_reserved_offset(const shared_metadata &metadata)
+{
+	return metadata.reserved_offset;
+}
+
+static std::string copy_name(const private_handle_t *, const legacy_shared_metadata &metadata)
+{
+	return std::string(metadata.name.data(), std::min(metadata.name.size, metadata.name.capacity()));
+}
+
+static std::vector<uint8_t> copy_smpte2094_40(const private_handle_t *, const legacy_shared_metadata &metadata)
+{
+	const uint8_t *begin = metadata.smpte2094_40.data();
+	return std::vector<uint8_t>(begin, begin + std::min(metadata.smpte2094_40.size, metadata.smpte2094_40.capacity()));
+}
+
+static bool store_smpte2094_40(const private_handle_t *, legacy_shared_metadata &metadata,
+                               const std::vector<uint8_t> &smpte2094_40)
+{
+	if (smpte2094_40.size() > metadata.smpte2094_40.capacity())
 	{
-		return name.size > 0
-		    ? std::string_view(name.data(), name.size)
-		    : std::string_view();
+		return false;
 	}
+	metadata.smpte2094_40.size = smpte2094_40.size();
+	std::memcpy(metadata.smpte2094_40.data(), smpte2094_40.data(), smpte2094_40.size());
+	return true;
+}
+
+static uint64_t get_reserved_offset(const legacy_shared_metadata &)
+{
+	return sizeof(legacy_shared_metadata);
+}
+
+/* Offsets of the variable sized parts of a shared metadata region. */
+struct region_layout
+{
+	uint32_t name_size;
+	uint64_t reserved_offset;
+	uint64_t smpte2094_40_offset;
+	uint64_t size;
 };
 
-static_assert(offsetof(shared_metadata, blend_mode) == 0, "bad alignment");
-static_assert(sizeof(shared_metadata::blend_mode) == 8, "bad size");
+static region_layout get_region_layout(std::string_view name, uint64_t reserved_size)
+{
+	const uint64_t page_size = getpagesize();
+	region_layout layout;
 
-static_assert(offsetof(shared_metadata, crop) == 8, "bad alignment");
-static_assert(sizeof(shared_metadata::crop) == 20, "bad size");
+	layout.name_size = std::min(name.size(), static_cast<size_t>(SHARED_METADATA_MAX_NAME));
+	layout.reserved_offset = GRALLOC_ALIGN(sizeof(shared_metadata) + layout.name_size, 8);
 
-static_assert(offsetof(shared_metadata, cta861_3) == 28, "bad alignment");
-static_assert(sizeof(shared_metadata::cta861_3) == 12, "bad size");
+	const uint64_t reserved_end = layout.reserved_offset + reserved_size;
+	layout.smpte2094_40_offset = GRALLOC_ALIGN(reserved_end, 8);
+	if (layout.smpte2094_40_offset / page_size !=
+	    (layout.smpte2094_40_offset + SHARED_METADATA_SMPTE2094_40_CAPACITY - 1) / page_size)
+	{
+		layout.smpte2094_40_offset = GRALLOC_ALIGN(reserved_end, page_size);
+	}
 
-static_assert(offsetof(shared_metadata, dataspace) == 40, "bad alignment");
-static_assert(sizeof(shared_metadata::dataspace) == 8, "bad size");
+	layout.size = layout.smpte2094_40_offset + SHARED_METADATA_SMPTE2094_40_CAPACITY;
 
-static_assert(offsetof(shared_metadata, chroma_siting) == 48, "bad alignment");
-static_assert(sizeof(shared_metadata::chroma_siting) == 16, "bad size");
+	/* See is_legacy_layout(). */
+	if (layout.size == sizeof(legacy_shared_metadata) + reserved_size)
+	{
+		layout.size += 8;
+	}
+	return layout;
+}
 
-static_assert(offsetof(shared_metadata, smpte2086) == 64, "bad alignment");
-static_assert(sizeof(shared_metadata::smpte2086) == 44, "bad size");
+uint64_t shared_metadata_size(std::string_view name, uint64_t reserved_size)
+{
+	return get_region_layout(name, reserved_size).size;
+}
 
-static_assert(offsetof(shared_metadata, smpte2094_40) == 108, "bad alignment");
-static_assert(sizeof(shared_metadata::smpte2094_40) == 2052, "bad size");
+void shared_metadata_init(void *memory, std::string_view name, uint64_t reserved_size)
+{
+	const region_layout layout = get_region_layout(name, reserved_size);
+	auto *metadata = new(memory) shared_metadata;
 
-static_assert(offsetof(shared_metadata, name) == 2160, "bad alignment");
-static_assert(sizeof(shared_metadata::name) == 260, "bad size");
+	metadata->reserved_offset = layout.reserved_offset;
+	metadata->name = { sizeof(shared_metadata), layout.name_size, layout.name_size };
+	std::memcpy(static_cast<uint8_t *>(memory) + sizeof(shared_metadata), name.data(), layout.name_size);
+	metadata->smpte2094_40 = { layout.smpte2094_40_offset, 0, SHARED_METADATA_SMPTE2094_40_CAPACITY };
+}
 
-static_assert(alignof(shared_metadata) == 8, "bad alignment");
-static_assert(sizeof(shared_metadata) == 2424, "bad size");
+/*
+ * Checks that the layout of metadata mapped from another process fits in its region.
+ *
+ * @return 0, when it does;
+ *         -EINVAL, otherwise.
+ */
+static int validate_layout(const private_handle_t *hnd)
+{
+	if (is_legacy_layout(hnd))
+	{
+		return 0;
+	}
+
+	if (hnd->attr_size < sizeof(shared_metadata))
+	{
+		MALI_GRALLOC_LOGE("Shared metadata region too small (%" PRIu64 " bytes)", hnd->attr_size);
+		return -EINVAL;
+	}
+
+	const auto *header = static_cast<const shared_metadata_header *>(hnd->attr_base);
+	if (header->version != SHARED_METADATA_VERSION)
+	{
+		MALI_GRALLOC_LOGE("Unknown shared metadata layout version %" PRIu32, header->version);
+		return -EINVAL;
+	}
+
+	const uint64_t reserved_offset =
+	    visit_metadata(hnd, [](const auto &metadata) { return get_reserved_offset(metadata); });
+	if (reserved_offset < sizeof(shared_metadata) || reserved_offset > hnd->attr_size ||
+	    hnd->reserved_region_size > hnd->attr_size - reserved_offset)
+	{
+		MALI_GRALLOC_LOGE("Reserved region out of the shared metadata region");
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+/*
+ * Shared metadata mappings of the buffers imported in this process, by backing store.
+ *
+ * Composers import the same buffers over and over, each time through a new handle with its
+ * own duplicate of share_attr_fd. All the handles of a backing store share one mapping, which
+ * is unmapped when the last of them is freed. The inode of share_attr_fd is compared as well,
+ * so that a backing_store_id reused by a restarted allocator never returns a stale mapping.
+ */
+class shared_metadata_mappings
+{
+public:
+	int map(private_handle_t *hnd)
+	{
+		struct stat st;
+		if (fstat(hnd->share_attr_fd, &st) < 0)
+		{
+			return -errno;
+		}
+
+		std::lock_guard<std::mutex> lock(m_lock);
+
+		auto it = m_mappings.find(hnd->backing_store_id);
+		if (it != m_mappings.end() && it->second.inode == st.st_ino && it->second.size == hnd->attr_size)
+		{
+			it->second.refs++;
+			hnd->attr_base = it->second.base;
+			return 0;
+		}
+
+		void *base = mmap(nullptr, hnd->attr_size, PROT_READ | PROT_WRITE, MAP_SHARED, hnd->share_attr_fd, 0);
+		if (base == MAP_FAILED)
+		{
+			return -errno;
+		}
+
+		hnd->attr_base = base;
+		const int ret = validate_layout(hnd);
+		if (ret < 0)
+		{
+			munmap(base, hnd->attr_size);
+			hnd->attr_base = MAP_FAILED;
+			return ret;
+		}
+
+		/* A stale mapping of a reused backing_store_id stays with the handles still using it. */
+		if (it == m_mappings.end())
+		{
+			m_mappings.emplace(hnd->backing_store_id, mapping{ st.st_ino, base, hnd->attr_size, 1 });
+		}
+
+		return 0;
+	}
+
+	void unmap(private_handle_t *hnd)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+
+			auto it = m_mappings.find(hnd->backing_store_id);
+			if (it != m_mappings.end() && it->second.base == hnd->attr_base)
+			{
+				if (--it->second.refs > 0)
+				{
+					hnd->attr_base = MAP_FAILED;
+					return;
+				}
+				m_mappings.erase(it);
+			}
+		}
+
+		if (munmap(hnd->attr_base, hnd->attr_size) < 0)
+		{
+			MALI_GRALLOC_LOGW("munmap: %s", strerror(errno));
+		}
+		hnd->attr_base = MAP_FAILED;
+	}
+
+private:
+	struct mapping
+	{
+		ino_t inode;
+		void *base;
+		uint64_t size;
+		uint32_t refs;
+	};
+
+	std::mutex m_lock;
+	std::unordered_map<uint64_t, mapping> m_mappings;
+};
+
+/* Leaked, like the registered handle pool, as buffers may be freed during process termination. */
+static shared_metadata_mappings *s_mappings = new shared_metadata_mappings;
 
-void shared_metadata_init(void *memory, std::string_view name)
+int import_shared_metadata(private_handle_t *hnd)
 {
-	new(memory) shared_metadata(name);
+	const int ret = s_mappings->map(hnd);
+	if (ret == 0 && !is_legacy_layout(hnd))
+	{
+		visit_metadata(hnd->attr_base,
+		               [](auto &metadata) { metadata.imports.fetch_add(1, std::memory_order_relaxed); });
+	}
+	return ret;
 }
 
-size_t shared_metadata_size()
+void release_shared_metadata(private_handle_t *hnd)
 {
-	return sizeof(shared_metadata);
+	if (!is_legacy_layout(hnd))
+	{
+		visit_metadata(hnd->attr_base,
+		               [](auto &metadata) { metadata.releases.fetch_add(1, std::memory_order_release); });
+	}
+	s_mappings->unmap(hnd);
+}
+
+void *get_reserved_region(const private_handle_t *hnd)
+{
+	const uint64_t offset =
+	    visit_metadata(hnd, [](const auto &metadata) { return get_reserved_offset(metadata); });
+	if (offset > hnd->attr_size || hnd->reserved_region_size > hnd->attr_size - offset)
+	{
+		return nullptr;
+	}
+	return static_cast<uint8_t *>(hnd->attr_base) + offset;
+}
+
+void record_cpu_lock(const private_handle_t *hnd, bool read, bool write)
+{
+	if (is_legacy_layout(hnd))
+	{
+		return;
+	}
+
+	visit_metadata(hnd->attr_base, [read, write](auto &metadata) {
+		if (read)
+		{
+			metadata.cpu_read_locks.fetch_add(1, std::memory_order_relaxed);
+		}
+		if (write)
+		{
+			metadata.cpu_write_locks.fetch_add(1, std::memory_order_relaxed);
+		}
+	});
+}
+
+void get_cpu_lock_counts(const void *memory, uint32_t *read_locks, uint32_t *write_locks)
+{
+	visit_metadata(const_cast<void *>(memory), [read_locks, write_locks](const auto &metadata) {
+		*read_locks = metadata.cpu_read_locks.load(std::memory_order_relaxed);
+		*write_locks = metadata.cpu_write_locks.load(std::memory_order_relaxed);
+	});
+}
+
+bool is_buffer_released(const void *memory)
+{
+	return visit_metadata(const_cast<void *>(memory), [](const auto &metadata) {
+		/* Releases are loaded first, so that an import counted after them is seen. */
+		const uint32_t releases = metadata.releases.load(std::memory_order_acquire);
+		const uint32_t imports = metadata.imports.load(std::memory_order_relaxed);
+		return imports != 0 && imports == releases;
+	});
+}
+
+bool get_metadata_generation(const private_handle_t *hnd, uint32_t *generation)
+{
+	if (is_legacy_layout(hnd))
+	{
+		return false;
+	}
+
+	auto *header = static_cast<const shared_metadata_header *>(hnd->attr_base);
+	*generation = header->sequence.load(std::memory_order_acquire) / 2;
+	return true;
 }
 
 void get_name(const private_handle_t *hnd, std::string *name)
 {
-	auto *metadata = reinterpret_cast<const shared_metadata *>(hnd->attr_base);
-	*name = metadata->get_name();
+	*name = read_metadata(hnd, [hnd](const auto &metadata) { return copy_name(hnd, metadata); });
 }
 
 void get_crop_rect(const private_handle_t *hnd, std::optional<Rect> *crop)
 {
-	auto *metadata = reinterpret_cast<const shared_metadata *>(hnd->attr_base);
-	*crop = metadata->crop.to_std_optional();
+	*crop = read_metadata(hnd, [](const auto &metadata) { return metadata.crop; }).to_std_optional();
 }
 
 android::status_t set_crop_rect(const private_handle_t *hnd, const Rect &crop)
 {
-	auto *metadata = reinterpret_cast<shared_metadata *>(hnd->attr_base);
-
 	if (crop.top < 0 || crop.left < 0 ||
 	    crop.left > crop.right || crop.right > hnd->plane_info[0].alloc_width ||
 	    crop.top > crop.bottom || crop.bottom > hnd->plane_info[0].alloc_height ||
@@ -180,20 +688,19 @@ android::status_t set_crop_rect(const private_handle_t *hnd, const Rect &crop)
 		return android::BAD_VALUE;
 	}
 
-	metadata->crop = aligned_optional(crop);
+	write_metadata(hnd, [&crop](auto &metadata) { metadata.crop = aligned_optional(crop); });
 	return android::OK;
 }
 
 void get_dataspace(const private_handle_t *hnd, std::optional<Dataspace> *dataspace)
 {
-	auto *metadata = reinterpret_cast<const shared_metadata *>(hnd->attr_base);
-	*dataspace = metadata->dataspace.to_std_optional();
+	*dataspace = read_metadata(hnd, [](const auto &metadata) { return metadata.dataspace; })
+	                 .to_std_optional();
 }
 
 void set_dataspace(const private_handle_t *hnd, const Dataspace &dataspace)
 {
-	auto *metadata = reinterpret_cast<shared_metadata *>(hnd->attr_base);
-	metadata->dataspace = aligned_optional(dataspace);
+	write_metadata(hnd, [&dataspace](auto &metadata) { metadata.dataspace = aligned_optional(dataspace); });
 }
 
 bool chroma_siting_is_arm_value(int64_t val)
@@ -210,8 +717,8 @@ bool chroma_siting_is_arm_value(int64_t val)
 }
 void get_chroma_siting(const private_handle_t *hnd, std::optional<ExtendableType> *chroma_siting)
 {
-	auto *metadata = reinterpret_cast<const shared_metadata *>(hnd->attr_base);
-	auto stored_value = metadata->chroma_siting.to_std_optional();
+	auto stored_value = read_metadata(hnd, [](const auto &metadata) { return metadata.chroma_siting; })
+	                        .to_std_optional();
 	if (stored_value.has_value())
 	{
 		int64_t value = stored_value.value();
@@ -223,26 +730,26 @@ void get_chroma_siting(const private_handle_t *hnd, std::optional<ExtendableType
 
 void set_chroma_siting(const private_handle_t *hnd, const ExtendableType &chroma_siting)
 {
-	auto *metadata = reinterpret_cast<shared_metadata *>(hnd->attr_base);
-	metadata->chroma_siting = aligned_optional(chroma_siting.value);
+	write_metadata(hnd, [&chroma_siting](auto &metadata) {
+		metadata.chroma_siting = aligned_optional(chroma_siting.value);
+	});
 }
 
 void get_blend_mode(const private_handle_t *hnd, std::optional<BlendMode> *blend_mode)
 {
-	auto *metadata = reinterpret_cast<const shared_metadata *>(hnd->attr_base);
-	*blend_mode = metadata->blend_mode.to_std_optional();
+	*blend_mode = read_metadata(hnd, [](const auto &metadata) { return metadata.blend_mode; })
+	                  .to_std_optional();
 }
 
 void set_blend_mode(const private_handle_t *hnd, const BlendMode &blend_mode)
 {
-	auto *metadata = reinterpret_cast<shared_metadata *>(hnd->attr_base);
-	metadata->blend_mode = aligned_optional(blend_mode);
+	write_metadata(hnd, [&blend_mode](auto &metadata) { metadata.blend_mode = aligned_optional(blend_mode); });
 }
 
 void get_smpte2086(const private_handle_t *hnd, std::optional<Smpte2086> *smpte2086)
 {
-	auto *metadata = reinterpret_cast<const shared_metadata *>(hnd->attr_base);
-	*smpte2086 = metadata->smpte2086.to_std_optional();
+	*smpte2086 = read_metadata(hnd, [](const auto &metadata) { return metadata.smpte2086; })
+	                 .to_std_optional();
 }
 
 android::status_t set_smpte2086(const private_handle_t *hnd, const std::optional<Smpte2086> &smpte2086)
@@ -252,16 +759,15 @@ android::status_t set_smpte2086(const private_handle_t *hnd, const std::optional
 		return android::BAD_VALUE;
 	}
 
-	auto *metadata = reinterpret_cast<shared_metadata *>(hnd->attr_base);
-	metadata->smpte2086 = aligned_optional(smpte2086);
+	write_metadata(hnd, [&smpte2086](auto &metadata) { metadata.smpte2086 = aligned_optional(smpte2086); });
 
 	return android::OK;
 }
 
 void get_cta861_3(const private_handle_t *hnd, std::optional<Cta861_3> *cta861_3)
 {
-	auto *metadata = reinterpret_cast<const shared_metadata *>(hnd->attr_base);
-	*cta861_3 = metadata->cta861_3.to_std_optional();
+	*cta861_3 = read_metadata(hnd, [](const auto &metadata) { return metadata.cta861_3; })
+	                .to_std_optional();
 }
 
 android::status_t set_cta861_3(const private_handle_t *hnd, const std::optional<Cta861_3> &cta861_3)
@@ -271,20 +777,17 @@ android::status_t set_cta861_3(const private_handle_t *hnd, const std::optional<
 		return android::BAD_VALUE;
 	}
 
-	auto *metadata = reinterpret_cast<shared_metadata *>(hnd->attr_base);
-	metadata->cta861_3 = aligned_optional(cta861_3);
+	write_metadata(hnd, [&cta861_3](auto &metadata) { metadata.cta861_3 = aligned_optional(cta861_3); });
 
 	return android::OK;
 }
 
 void get_smpte2094_40(const private_handle_t *hnd, std::optional<std::vector<uint8_t>> *smpte2094_40)
 {
-	auto *metadata = reinterpret_cast<const shared_metadata *>(hnd->attr_base);
-	if (metadata->smpte2094_40.size > 0)
+	auto copy = read_metadata(hnd, [hnd](const auto &metadata) { return copy_smpte2094_40(hnd, metadata); });
+	if (copy.size() > 0)
 	{
-		const uint8_t *begin = metadata->smpte2094_40.data();
-		const uint8_t *end = begin + metadata->smpte2094_40.size;
-		smpte2094_40->emplace(begin, end);
+		smpte2094_40->emplace(std::move(copy));
 	}
 	else
 	{
@@ -300,17 +803,16 @@ android::status_t set_smpte2094_40(const private_handle_t *hnd, const std::optio
 		return android::BAD_VALUE;
 	}
 
-	auto *metadata = reinterpret_cast<shared_metadata *>(hnd->attr_base);
-	const size_t size = smpte2094_40.has_value() ? smpte2094_40->size() : 0;
-	if (size > metadata->smpte2094_40.capacity())
+	bool stored = false;
+	write_metadata(hnd, [hnd, &smpte2094_40, &stored](auto &metadata) {
+		stored = store_smpte2094_40(hnd, metadata, *smpte2094_40);
+	});
+	if (!stored)
 	{
 		MALI_GRALLOC_LOGE("SMPTE 2094-40 metadata too large to fit in shared metadata region");
 		return android::BAD_VALUE;
 	}
 
-	metadata->smpte2094_40.size = size;
-	std::memcpy(metadata->smpte2094_40.data(), smpte2094_40->data(), size);
-
 	return android::OK;
 }
 
@@ -41,8 +41,63 @@ using aidl::android::hardware::graphics::common::BlendMode;
 using aidl::android::hardware::graphics::common::Dataspace;
 using aidl::android::hardware::graphics::common::ExtendableType;
 
-void shared_metadata_init(void *memory, std::string_view name);
-size_t shared_metadata_size();
+/*
+ * Returns the size of the shared metadata region of a buffer: the metadata, the buffer name and
+ * a client reserved region of 'reserved_size' bytes.
+ */
+uint64_t shared_metadata_size(std::string_view name, uint64_t reserved_size);
+
+/*
+ * Initialises the shared metadata region at 'memory', of shared_metadata_size() bytes.
+ */
+void shared_metadata_init(void *memory, std::string_view name, uint64_t reserved_size);
+
+/*
+ * Returns the client reserved region of the buffer, in its shared metadata region; nullptr,
+ * if the metadata places it outside of the region.
+ */
+void *get_reserved_region(const private_handle_t *hnd);
+
+/*
+ * Maps the shared metadata of an imported buffer at hnd->attr_base. The handles of a backing
+ * store imported in this process share one mapping.
+ *
+ * @return 0, on success;
+ *         -EINVAL, when the metadata has an unknown layout or does not fit in its region;
+ *         -errno, otherwise.
+ */
+int import_shared_metadata(private_handle_t *hnd);
+
+/*
+ * Releases the mapping taken by import_shared_metadata(), setting hnd->attr_base to MAP_FAILED.
+ */
+void release_shared_metadata(private_handle_t *hnd);
+
+/*
+ * Counts a CPU lock of the buffer in its shared metadata.
+ */
+void record_cpu_lock(const private_handle_t *hnd, bool read, bool write);
+
+/*
+ * Reads the CPU lock counts from shared metadata mapped at 'memory'.
+ */
+void get_cpu_lock_counts(const void *memory, uint32_t *read_locks, uint32_t *write_locks);
+
+/*
+ * Returns whether every handle of the buffer imported so far, in any process, was freed, from
+ * shared metadata mapped at 'memory'. A buffer that was never imported is not released. A
+ * process that dies without freeing its handles keeps the buffer from being seen as released.
+ */
+bool is_buffer_released(const void *memory);
+
+/*
+ * Gets the number of updates of the shared metadata of the buffer, from all processes.
+ * Consumers may compare it against the value they last saw, to skip reading metadata that
+ * has not changed.
+ *
+ * @return false, for buffers allocated by gralloc releases which did not count the updates.
+ */
+bool get_metadata_generation(const private_handle_t *hnd, uint32_t *generation);
 
 void get_name(const private_handle_t *hnd, std::string *name);
 
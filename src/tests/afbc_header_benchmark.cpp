@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2022 Arm Limited. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Cost of initialising the AFBC headers of a buffer, compared with the per-superblock memcpy
+ * it replaced.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+#include "core/buffer_allocation.h"
+#include "core/internal_format.h"
+
+void init_afbc(uint8_t *buf, const internal_format_t alloc_format,
+               const bool is_multi_plane,
+               const int w, const int h);
+uint32_t afbc_header_size(const int w, const int h);
+
+/* Size of an AFBC header entry, one per superblock. */
+static constexpr uint32_t header_entry_bytes = 16;
+
+/* Common resolutions, aligned to 16x16 superblocks. */
+static void resolutions(benchmark::internal::Benchmark *b)
+{
+	b->Args({ 1280, 720 });
+	b->Args({ 1920, 1088 });
+	b->Args({ 2560, 1440 });
+	b->Args({ 3840, 2160 });
+}
+
+/* Header initialisation as done before the wide store writer. */
+static void init_afbc_per_superblock(uint8_t *buf, const uint32_t header[4], const uint32_t n_headers)
+{
+	for (uint32_t i = 0; i < n_headers; i++)
+	{
+		memcpy(buf, header, header_entry_bytes);
+		buf += header_entry_bytes;
+	}
+}
+
+static void BM_init_afbc(benchmark::State &state, mali_gralloc_android_format format)
+{
+	const int w = state.range(0);
+	const int h = state.range(1);
+	const internal_format_t alloc_format = internal_format_t::from_private(format);
+	std::vector<uint8_t> buf(afbc_header_size(w, h));
+
+	for (auto _ : state)
+	{
+		init_afbc(buf.data(), alloc_format, false, w, h);
+		benchmark::ClobberMemory();
+	}
+	state.SetBytesProcessed(state.iterations() * buf.size());
+}
+BENCHMARK_CAPTURE(BM_init_afbc, rgba8888,
+                  GRALLOC_PRIVATE_FORMAT_WRAPPER_AFBC(MALI_GRALLOC_FORMAT_INTERNAL_RGBA_8888))
+    ->Apply(resolutions);
+BENCHMARK_CAPTURE(BM_init_afbc, rgba8888_tiled,
+                  GRALLOC_PRIVATE_FORMAT_WRAPPER_AFBC_TILED_HEADERS_BASIC(MALI_GRALLOC_FORMAT_INTERNAL_RGBA_8888))
+    ->Apply(resolutions);
+BENCHMARK_CAPTURE(BM_init_afbc, yuv420_8bit,
+                  GRALLOC_PRIVATE_FORMAT_WRAPPER_AFBC(MALI_GRALLOC_FORMAT_INTERNAL_YUV420_8BIT_I))
+    ->Apply(resolutions);
+
+static void BM_init_afbc_per_superblock(benchmark::State &state)
+{
+	const int w = state.range(0);
+	const int h = state.range(1);
+	const uint32_t n_headers = afbc_header_size(w, h) / header_entry_bytes;
+	const uint32_t header[4] = { afbc_header_size(w, h), 0x1, 0x10000, 0x0 };
+	std::vector<uint8_t> buf(afbc_header_size(w, h));
+
+	for (auto _ : state)
+	{
+		init_afbc_per_superblock(buf.data(), header, n_headers);
+		benchmark::ClobberMemory();
+	}
+	state.SetBytesProcessed(state.iterations() * buf.size());
+}
+BENCHMARK(BM_init_afbc_per_superblock)->Apply(resolutions);
@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2022 Arm Limited. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Allocation and CPU lock paths of gralloc, run on the host against the memfd allocator.
+ */
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "core/buffer_access.h"
+#include "core/buffer_allocation.h"
+#include "core/buffer_copy.h"
+#include "test_buffers.h"
+
+TEST(Allocation, AllocateLockFree)
+{
+	private_handle_t *hnd = test_buffer_allocate(64, 64, HAL_PIXEL_FORMAT_RGBA_8888);
+	ASSERT_NE(hnd, nullptr);
+	EXPECT_EQ(hnd->width, 64);
+	EXPECT_EQ(hnd->height, 64);
+	EXPECT_GE(hnd->size, 64u * 64u * 4u);
+
+	void *vaddr = nullptr;
+	ASSERT_EQ(mali_gralloc_lock(hnd, GRALLOC_USAGE_SW_WRITE_OFTEN, 0, 0, 64, 64, &vaddr), 0);
+	ASSERT_NE(vaddr, nullptr);
+	const int stride = hnd->plane_info[0].byte_stride;
+	for (int y = 0; y < 64; y++)
+	{
+		memset(static_cast<uint8_t *>(vaddr) + y * stride, y, 64 * 4);
+	}
+	EXPECT_EQ(mali_gralloc_unlock(hnd), 0);
+
+	ASSERT_EQ(mali_gralloc_lock(hnd, GRALLOC_USAGE_SW_READ_OFTEN, 0, 0, 64, 64, &vaddr), 0);
+	for (int y = 0; y < 64; y++)
+	{
+		EXPECT_EQ(static_cast<uint8_t *>(vaddr)[y * stride + 64 * 4 - 1], y);
+	}
+	EXPECT_EQ(mali_gralloc_unlock(hnd), 0);
+
+	test_buffer_free(hnd);
+}
+
+TEST(Allocation, LockYCbCr)
+{
+	private_handle_t *hnd = test_buffer_allocate(128, 64, HAL_PIXEL_FORMAT_YCbCr_420_888);
+	ASSERT_NE(hnd, nullptr);
+
+	android_ycbcr ycbcr{};
+	ASSERT_EQ(mali_gralloc_lock_ycbcr(hnd, GRALLOC_USAGE_SW_WRITE_OFTEN, 0, 0, 128, 64, &ycbcr), 0);
+	EXPECT_NE(ycbcr.y, nullptr);
+	EXPECT_NE(ycbcr.cb, nullptr);
+	EXPECT_NE(ycbcr.cr, nullptr);
+	EXPECT_GE(ycbcr.ystride, 128u);
+	EXPECT_EQ(mali_gralloc_unlock(hnd), 0);
+
+	test_buffer_free(hnd);
+}
+
+TEST(Allocation, ProtectedIsRejected)
+{
+	buffer_descriptor_t descriptor = test_buffer_descriptor(16, 16, HAL_PIXEL_FORMAT_RGBA_8888);
+	descriptor.producer_usage |= GRALLOC_USAGE_PROTECTED;
+
+	private_handle_t *hnd = nullptr;
+	EXPECT_NE(mali_gralloc_buffer_allocate(&descriptor, &hnd), 0);
+}
+
+/* Every layer of a multi-layer AFBC buffer has its header initialised, not only the first. */
+TEST(Allocation, AfbcHeadersOfEveryLayer)
+{
+	buffer_descriptor_t descriptor = test_buffer_descriptor(
+	    64, 64, GRALLOC_PRIVATE_FORMAT_WRAPPER_AFBC(MALI_GRALLOC_FORMAT_INTERNAL_RGBA_8888),
+	    GRALLOC_USAGE_HW_TEXTURE | GRALLOC_USAGE_HW_RENDER);
+	descriptor.layer_count = 3;
+
+	private_handle_t *hnd = nullptr;
+	ASSERT_EQ(mali_gralloc_buffer_allocate(&descriptor, &hnd), 0);
+	ASSERT_TRUE(hnd->get_alloc_format().is_afbc());
+
+	const uint64_t layer_size = hnd->size / descriptor.layer_count;
+	for (uint32_t layer = 0; layer < descriptor.layer_count; layer++)
+	{
+		const uint32_t *header = reinterpret_cast<const uint32_t *>(static_cast<uint8_t *>(hnd->base) + layer * layer_size);
+		/* The first word of an untiled header is the offset of the body, which follows the headers. */
+		EXPECT_NE(header[0], 0u) << "layer " << layer;
+		EXPECT_EQ(header[0], reinterpret_cast<const uint32_t *>(hnd->base)[0]) << "layer " << layer;
+	}
+
+	test_buffer_free(hnd);
+}
+
+/* Overlapping CPU locks are granted, whatever their access. */
+TEST(Allocation, OverlappingLocks)
+{
+	private_handle_t *hnd = test_buffer_allocate(64, 64, HAL_PIXEL_FORMAT_RGBA_8888);
+	ASSERT_NE(hnd, nullptr);
+
+	void *vaddr = nullptr;
+	ASSERT_EQ(mali_gralloc_lock(hnd, GRALLOC_USAGE_SW_WRITE_OFTEN, 0, 0, 32, 32, &vaddr), 0);
+	ASSERT_EQ(mali_gralloc_lock(hnd, GRALLOC_USAGE_SW_READ_OFTEN, 16, 16, 48, 48, &vaddr), 0);
+	ASSERT_EQ(mali_gralloc_lock(hnd, GRALLOC_USAGE_SW_WRITE_OFTEN, 0, 0, 64, 64, &vaddr), 0);
+	EXPECT_EQ(mali_gralloc_unlock(hnd), 0);
+	EXPECT_EQ(mali_gralloc_unlock(hnd), 0);
+	EXPECT_EQ(mali_gralloc_unlock(hnd), 0);
+	EXPECT_EQ(hnd->lock_state.load() & (private_handle_t::LOCK_STATE_READ_MASK | private_handle_t::LOCK_STATE_WRITE), 0);
+
+	test_buffer_free(hnd);
+}
+
+/* Rectangle copies round-trip, through the write-combining loops from an unaligned column. */
+TEST(Allocation, CopyRectangle)
+{
+	private_handle_t *hnd = test_buffer_allocate(256, 16, HAL_PIXEL_FORMAT_RGBA_8888);
+	ASSERT_NE(hnd, nullptr);
+	hnd->flags |= private_handle_t::PRIV_FLAGS_USES_DBH_UNCACHED;
+
+	const int x = 3, y = 2, w = 200, h = 10;
+	std::vector<uint8_t> src(w * 4 * h), dst(w * 4 * h);
+	for (size_t i = 0; i < src.size(); i++)
+	{
+		src[i] = i * 7;
+	}
+
+	void *vaddr = nullptr;
+	ASSERT_EQ(mali_gralloc_lock(hnd, GRALLOC_USAGE_SW_WRITE_OFTEN | GRALLOC_USAGE_SW_READ_OFTEN, 0, 0, 256, 16,
+	                            &vaddr), 0);
+	EXPECT_EQ(mali_gralloc_copy_to_plane(hnd, vaddr, 0, x, y, w, h, src.data(), w * 4), 0);
+	EXPECT_EQ(mali_gralloc_copy_from_plane(hnd, vaddr, 0, x, y, w, h, dst.data(), w * 4), 0);
+	EXPECT_EQ(src, dst);
+	EXPECT_EQ(mali_gralloc_copy_to_plane(hnd, vaddr, 0, 100, 0, 200, 1, src.data(), w * 4), -EINVAL);
+	EXPECT_EQ(mali_gralloc_unlock(hnd), 0);
+
+	EXPECT_EQ(mali_gralloc_copy_to_plane(hnd, vaddr, 0, x, y, w, h, src.data(), w * 4), -EPERM);
+
+	test_buffer_free(hnd);
+}
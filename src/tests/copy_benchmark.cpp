@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2022 Arm Limited. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Rectangle copies into and out of locked planes, whole frames of NV12 and RGBA. The memfd
+ * allocator gives CPU cached memory only: the uncached variants force the write-combining
+ * copy loops onto it, which measures their instruction cost, not write-combined memory.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+#include "core/buffer_access.h"
+#include "core/buffer_copy.h"
+#include "core/format_info.h"
+#include "test_buffers.h"
+
+static void resolutions(benchmark::internal::Benchmark *b)
+{
+	b->Args({ 1920, 1080 });
+	b->Args({ 3840, 2160 });
+}
+
+enum class direction
+{
+	to_plane,
+	from_plane,
+};
+
+static void BM_copy(benchmark::State &state, uint64_t format, direction dir, bool uncached)
+{
+	const int width = state.range(0);
+	const int height = state.range(1);
+	private_handle_t *hnd = test_buffer_allocate(width, height, format);
+	if (hnd == nullptr)
+	{
+		state.SkipWithError("allocation failed");
+		return;
+	}
+	if (uncached)
+	{
+		hnd->flags |= private_handle_t::PRIV_FLAGS_USES_DBH_UNCACHED;
+	}
+
+	const auto *format_info = hnd->get_alloc_format().get_base_info();
+	struct plane_rect
+	{
+		int w, h;
+		size_t stride;
+		std::vector<uint8_t> memory;
+	};
+	std::vector<plane_rect> planes;
+	for (uint32_t plane = 0; plane < format_info->npln; plane++)
+	{
+		const int hsub = plane > 0 ? std::max<int>(format_info->hsub, 1) : 1;
+		const int vsub = plane > 0 ? std::max<int>(format_info->vsub, 1) : 1;
+		const int w = width / hsub;
+		const int h = height / vsub;
+		const size_t stride = static_cast<size_t>(w) * (format_info->bpp[plane] / 8);
+		planes.push_back({ w, h, stride, std::vector<uint8_t>(stride * h, 0x80) });
+	}
+
+	const uint64_t usage = dir == direction::to_plane ? GRALLOC_USAGE_SW_WRITE_OFTEN : GRALLOC_USAGE_SW_READ_OFTEN;
+	void *vaddr = nullptr;
+	if (mali_gralloc_lock(hnd, usage, 0, 0, width, height, &vaddr) != 0)
+	{
+		state.SkipWithError("lock failed");
+		test_buffer_free(hnd);
+		return;
+	}
+
+	size_t bytes = 0;
+	for (auto _ : state)
+	{
+		bytes = 0;
+		for (uint32_t plane = 0; plane < planes.size(); plane++)
+		{
+			plane_rect &r = planes[plane];
+			const int ret = dir == direction::to_plane
+			    ? mali_gralloc_copy_to_plane(hnd, vaddr, plane, 0, 0, r.w, r.h, r.memory.data(), r.stride)
+			    : mali_gralloc_copy_from_plane(hnd, vaddr, plane, 0, 0, r.w, r.h, r.memory.data(), r.stride);
+			if (ret != 0)
+			{
+				state.SkipWithError("copy failed");
+				break;
+			}
+			bytes += r.memory.size();
+		}
+		benchmark::ClobberMemory();
+	}
+	state.SetBytesProcessed(state.iterations() * bytes);
+
+	mali_gralloc_unlock(hnd);
+	test_buffer_free(hnd);
+}
+BENCHMARK_CAPTURE(BM_copy, rgba8888_to_plane, HAL_PIXEL_FORMAT_RGBA_8888, direction::to_plane, false)
+    ->Apply(resolutions);
+BENCHMARK_CAPTURE(BM_copy, rgba8888_to_plane_uncached, HAL_PIXEL_FORMAT_RGBA_8888, direction::to_plane, true)
+    ->Apply(resolutions);
+BENCHMARK_CAPTURE(BM_copy, rgba8888_from_plane, HAL_PIXEL_FORMAT_RGBA_8888, direction::from_plane, false)
+    ->Apply(resolutions);
+BENCHMARK_CAPTURE(BM_copy, rgba8888_from_plane_uncached, HAL_PIXEL_FORMAT_RGBA_8888, direction::from_plane, true)
+    ->Apply(resolutions);
+BENCHMARK_CAPTURE(BM_copy, nv12_to_plane, MALI_GRALLOC_FORMAT_INTERNAL_NV12, direction::to_plane, false)
+    ->Apply(resolutions);
+BENCHMARK_CAPTURE(BM_copy, nv12_to_plane_uncached, MALI_GRALLOC_FORMAT_INTERNAL_NV12, direction::to_plane, true)
+    ->Apply(resolutions);
+BENCHMARK_CAPTURE(BM_copy, nv12_from_plane, MALI_GRALLOC_FORMAT_INTERNAL_NV12, direction::from_plane, false)
+    ->Apply(resolutions);
+BENCHMARK_CAPTURE(BM_copy, nv12_from_plane_uncached, MALI_GRALLOC_FORMAT_INTERNAL_NV12, direction::from_plane, true)
+    ->Apply(resolutions);
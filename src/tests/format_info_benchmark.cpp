@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2022 Arm Limited. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Per-call cost of the indexed format lookups, compared with the linear scan of the format
+ * table they replaced. Each iteration looks up every base format once.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+#include <system/graphics.h>
+
+#include "core/format_info.h"
+
+static std::vector<uint32_t> get_base_format_ids()
+{
+	std::vector<uint32_t> ids;
+	for (const auto &format : get_all_base_formats())
+	{
+		ids.push_back(format.id);
+	}
+	return ids;
+}
+
+static void BM_get_format_info(benchmark::State &state)
+{
+	const auto ids = get_base_format_ids();
+	for (auto _ : state)
+	{
+		for (const uint32_t id : ids)
+		{
+			benchmark::DoNotOptimize(get_format_info(id));
+		}
+	}
+	state.SetItemsProcessed(state.iterations() * ids.size());
+}
+BENCHMARK(BM_get_format_info);
+
+static void BM_get_format_info_linear_scan(benchmark::State &state)
+{
+	const auto ids = get_base_format_ids();
+	const auto &formats = get_all_base_formats();
+	for (auto _ : state)
+	{
+		for (const uint32_t id : ids)
+		{
+			const format_info_t *info = nullptr;
+			for (const auto &format : formats)
+			{
+				if (format.id == id)
+				{
+					info = &format;
+					break;
+				}
+			}
+			benchmark::DoNotOptimize(info);
+		}
+	}
+	state.SetItemsProcessed(state.iterations() * ids.size());
+}
+BENCHMARK(BM_get_format_info_linear_scan);
+
+static void BM_get_format_ip_support(benchmark::State &state)
+{
+	const auto ids = get_base_format_ids();
+	for (auto _ : state)
+	{
+		for (const uint32_t id : ids)
+		{
+			benchmark::DoNotOptimize(get_format_ip_support(id));
+		}
+	}
+	state.SetItemsProcessed(state.iterations() * ids.size());
+}
+BENCHMARK(BM_get_format_ip_support);
+
+static void BM_get_internal_format(benchmark::State &state)
+{
+	const auto ids = get_base_format_ids();
+	for (auto _ : state)
+	{
+		for (const uint32_t id : ids)
+		{
+			benchmark::DoNotOptimize(get_internal_format(id));
+		}
+	}
+	state.SetItemsProcessed(state.iterations() * ids.size());
+}
+BENCHMARK(BM_get_internal_format);
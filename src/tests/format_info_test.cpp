@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2022 Arm Limited. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * The indexed format lookups against a linear scan of the format tables.
+ */
+
+#include <gtest/gtest.h>
+
+#include <system/graphics.h>
+
+#include "core/format_info.h"
+#include "gralloc/formats.h"
+
+static const format_info_t *find_format_info(uint32_t base_format)
+{
+	for (const auto &format : get_all_base_formats())
+	{
+		if (format.id == base_format)
+		{
+			return &format;
+		}
+	}
+	return nullptr;
+}
+
+TEST(FormatInfo, LookupMatchesScan)
+{
+	/* Beyond the base format ID space too. */
+	for (uint32_t id = 0; id < 0x1000; id++)
+	{
+		EXPECT_EQ(get_format_info(id), find_format_info(id)) << std::hex << id;
+	}
+	EXPECT_EQ(get_format_info(HAL_PIXEL_FORMAT_YV12), find_format_info(HAL_PIXEL_FORMAT_YV12));
+}
+
+TEST(FormatInfo, IpSupportOfEveryFormat)
+{
+	for (const auto &format : get_all_base_formats())
+	{
+		const format_ip_support_t *ip_support = get_format_ip_support(format.id);
+		ASSERT_NE(ip_support, nullptr) << std::hex << format.id;
+		EXPECT_EQ(ip_support->id, format.id);
+	}
+	EXPECT_EQ(get_format_ip_support(0xfff), nullptr);
+}
+
+TEST(FormatInfo, InternalFormat)
+{
+	for (const auto &format : get_all_base_formats())
+	{
+		const uint32_t internal_format = get_internal_format(format.id);
+		EXPECT_NE(get_format_info(internal_format), nullptr) << std::hex << format.id;
+	}
+	EXPECT_EQ(get_internal_format(HAL_PIXEL_FORMAT_YV12), static_cast<uint32_t>(MALI_GRALLOC_FORMAT_INTERNAL_YV12));
+	EXPECT_EQ(get_internal_format(HAL_PIXEL_FORMAT_RGBA_8888),
+	          static_cast<uint32_t>(MALI_GRALLOC_FORMAT_INTERNAL_RGBA_8888));
+	EXPECT_EQ(get_internal_format(0xfff), static_cast<uint32_t>(MALI_GRALLOC_FORMAT_INTERNAL_UNDEFINED));
+}
@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2022 Arm Limited. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Contention of the CPU lock path: N threads lock and unlock M buffers in turn, as decoders
+ * and RenderEngine threads do. With M >= N the threads mostly work on distinct buffers.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "core/buffer_access.h"
+#include "test_buffers.h"
+
+static constexpr int max_buffers = 64;
+
+static const std::vector<private_handle_t *> &get_buffers()
+{
+	static std::vector<private_handle_t *> buffers;
+	static std::once_flag allocated;
+	std::call_once(allocated, [] {
+		for (int i = 0; i < max_buffers; i++)
+		{
+			buffers.push_back(test_buffer_allocate(256, 256, HAL_PIXEL_FORMAT_RGBA_8888));
+		}
+	});
+	return buffers;
+}
+
+static void BM_lock_unlock(benchmark::State &state)
+{
+	static std::atomic<int> next_thread{0};
+	const int thread = next_thread++;
+	const auto &buffers = get_buffers();
+	const int n_buffers = state.range(0);
+
+	int i = thread;
+	for (auto _ : state)
+	{
+		private_handle_t *hnd = buffers[i++ % n_buffers];
+		void *vaddr = nullptr;
+		if (mali_gralloc_lock(hnd, GRALLOC_USAGE_SW_READ_OFTEN, 0, 0, 256, 256, &vaddr) != 0)
+		{
+			state.SkipWithError("lock failed");
+			break;
+		}
+		benchmark::DoNotOptimize(vaddr);
+		mali_gralloc_unlock(hnd);
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_lock_unlock)->Arg(1)->Arg(8)->Arg(max_buffers)->ThreadRange(1, 8)->UseRealTime();
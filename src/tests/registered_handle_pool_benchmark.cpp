@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2022 Arm Limited. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Throughput of the registered handle pool of the mapper, against the single mutex and
+ * unordered_set it replaced. Every mapper call looks its buffer up in the pool, from the
+ * threads of SurfaceFlinger, HWC and RenderEngine at once; imports and frees are rarer.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+#include "hidl_common/registered_handle_pool.h"
+
+/* The pool as it was: one set behind one mutex. */
+class reference_handle_pool
+{
+public:
+	bool add(buffer_handle_t bufferHandle)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return bufPool.insert(bufferHandle).second;
+	}
+
+	native_handle_t *remove(void *buffer)
+	{
+		auto bufferHandle = static_cast<native_handle_t *>(buffer);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		return bufPool.erase(bufferHandle) == 1 ? bufferHandle : nullptr;
+	}
+
+	buffer_handle_t get(const void *buffer)
+	{
+		auto bufferHandle = static_cast<buffer_handle_t>(buffer);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		return bufPool.count(bufferHandle) == 1 ? bufferHandle : nullptr;
+	}
+
+private:
+	std::mutex mutex;
+	std::unordered_set<buffer_handle_t> bufPool;
+};
+
+/* Buffers imported by a composer: a few swapchains and layers. */
+static constexpr int num_handles = 256;
+
+/* Lookups between two frees and imports of a buffer, in the mixed benchmark. */
+static constexpr int lookups_per_import = 64;
+
+static const std::vector<native_handle_t *> &get_handles()
+{
+	static const std::vector<native_handle_t *> handles = [] {
+		std::vector<native_handle_t *> h;
+		for (int i = 0; i < num_handles; i++)
+		{
+			h.push_back(native_handle_create(0, 0));
+		}
+		return h;
+	}();
+	return handles;
+}
+
+template <typename Pool>
+static Pool &get_pool()
+{
+	static Pool *pool = [] {
+		auto *p = new Pool;
+		for (native_handle_t *h : get_handles())
+		{
+			p->add(h);
+		}
+		return p;
+	}();
+	return *pool;
+}
+
+template <typename Pool>
+static void BM_get(benchmark::State &state)
+{
+	Pool &pool = get_pool<Pool>();
+	const auto &handles = get_handles();
+
+	static std::atomic<int> next_thread{0};
+	int i = next_thread++ * 17;
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(pool.get(handles[i++ % num_handles]));
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_get, RegisteredHandlePool)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_get, reference_handle_pool)->ThreadRange(1, 8)->UseRealTime();
+
+/*
+ * Lookups with a free and an import every lookups_per_import of them. Each thread frees and
+ * imports a handle of its own, so that the others always find theirs.
+ */
+template <typename Pool>
+static void BM_get_with_imports(benchmark::State &state)
+{
+	Pool &pool = get_pool<Pool>();
+	const auto &handles = get_handles();
+	native_handle_t *own = native_handle_create(0, 0);
+	pool.add(own);
+
+	static std::atomic<int> next_thread{0};
+	int i = next_thread++ * 17;
+	for (auto _ : state)
+	{
+		if (i % lookups_per_import == 0)
+		{
+			pool.remove(own);
+			pool.add(own);
+		}
+		benchmark::DoNotOptimize(pool.get(handles[i++ % num_handles]));
+	}
+	state.SetItemsProcessed(state.iterations());
+
+	pool.remove(own);
+	native_handle_delete(own);
+}
+BENCHMARK_TEMPLATE(BM_get_with_imports, RegisteredHandlePool)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_get_with_imports, reference_handle_pool)->ThreadRange(1, 8)->UseRealTime();
@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2022 Arm Limited. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * The registered handle pool of the mapper, through its growth and the tombstones of removed
+ * handles.
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "hidl_common/registered_handle_pool.h"
+
+class RegisteredHandlePoolTest : public ::testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		for (int i = 0; i < 1000; i++)
+		{
+			handles.push_back(native_handle_create(0, 0));
+		}
+	}
+
+	void TearDown() override
+	{
+		for (native_handle_t *h : handles)
+		{
+			native_handle_delete(h);
+		}
+	}
+
+	std::vector<native_handle_t *> handles;
+};
+
+TEST_F(RegisteredHandlePoolTest, AddGetRemove)
+{
+	RegisteredHandlePool pool;
+	for (native_handle_t *h : handles)
+	{
+		EXPECT_TRUE(pool.add(h));
+	}
+	EXPECT_FALSE(pool.add(handles[0]));
+
+	for (native_handle_t *h : handles)
+	{
+		EXPECT_EQ(pool.get(h), h);
+	}
+
+	for (size_t i = 0; i < handles.size(); i += 2)
+	{
+		EXPECT_EQ(pool.remove(handles[i]), handles[i]);
+	}
+	EXPECT_EQ(pool.remove(handles[0]), nullptr);
+
+	for (size_t i = 0; i < handles.size(); i++)
+	{
+		EXPECT_EQ(pool.get(handles[i]), i % 2 ? handles[i] : nullptr);
+	}
+}
+
+/* Removes and adds of the same handles fill the tables with tombstones, which are cleared. */
+TEST_F(RegisteredHandlePoolTest, Churn)
+{
+	RegisteredHandlePool pool;
+	for (int round = 0; round < 100; round++)
+	{
+		for (size_t i = 0; i < 16; i++)
+		{
+			ASSERT_TRUE(pool.add(handles[round * 8 + i]));
+		}
+		for (size_t i = 0; i < 16; i++)
+		{
+			ASSERT_EQ(pool.remove(handles[round * 8 + i]), handles[round * 8 + i]);
+		}
+	}
+
+	for (native_handle_t *h : handles)
+	{
+		EXPECT_EQ(pool.get(h), nullptr);
+	}
+}
+
+TEST_F(RegisteredHandlePoolTest, ForEach)
+{
+	RegisteredHandlePool pool;
+	for (size_t i = 0; i < 100; i++)
+	{
+		pool.add(handles[i]);
+	}
+
+	std::vector<buffer_handle_t> seen;
+	pool.for_each([&seen](const buffer_handle_t &h) { seen.push_back(h); });
+	std::sort(seen.begin(), seen.end());
+
+	std::vector<buffer_handle_t> expected(handles.begin(), handles.begin() + 100);
+	std::sort(expected.begin(), expected.end());
+	EXPECT_EQ(seen, expected);
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2022 Arm Limited. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include "buffer.h"
+#include "core/buffer_allocation.h"
+#include "core/buffer_descriptor.h"
+
+/*
+ * Helpers shared by the host tests and benchmarks. Buffers come from the memfd allocator
+ * and are owned by the calling process, as buffers allocated by the allocator service are.
+ */
+
+static inline buffer_descriptor_t test_buffer_descriptor(uint32_t width, uint32_t height, uint64_t format,
+                                                         uint64_t usage = GRALLOC_USAGE_SW_READ_OFTEN
+                                                                          | GRALLOC_USAGE_SW_WRITE_OFTEN)
+{
+	buffer_descriptor_t descriptor;
+	descriptor.width = width;
+	descriptor.height = height;
+	descriptor.hal_format = format;
+	descriptor.producer_usage = usage;
+	descriptor.consumer_usage = usage;
+	descriptor.layer_count = 1;
+
+	return descriptor;
+}
+
+/* Returns nullptr when the allocation fails. */
+static inline private_handle_t *test_buffer_allocate(uint32_t width, uint32_t height, uint64_t format,
+                                                     uint64_t usage = GRALLOC_USAGE_SW_READ_OFTEN
+                                                                      | GRALLOC_USAGE_SW_WRITE_OFTEN)
+{
+	buffer_descriptor_t descriptor = test_buffer_descriptor(width, height, format, usage);
+
+	private_handle_t *hnd = nullptr;
+	if (mali_gralloc_buffer_allocate(&descriptor, &hnd) != 0)
+	{
+		return nullptr;
+	}
+
+	return hnd;
+}
+
+static inline void test_buffer_free(private_handle_t *hnd)
+{
+	mali_gralloc_buffer_free(hnd);
+	native_handle_delete(hnd);
+}
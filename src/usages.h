@@ -110,6 +110,12 @@ typedef enum
 	*/
 	RK_GRALLOC_USAGE_WITHIN_4G = GRALLOC_USAGE_PRIVATE_11,
 
+	/* The client's first CPU accesses after each lock are latency critical: the pages of the locked
+	 * region are populated by the lock, and large buffers are mapped aligned for large pages.
+	 * Also enabled for all buffers with vendor.gralloc.prefault_mappings.
+	 */
+	RK_GRALLOC_USAGE_PREFAULT_MAPPING = GRALLOC_USAGE_PRIVATE_6,
+
 	/* See comment for Gralloc 1.0, above. */
 	MALI_GRALLOC_USAGE_FRONTBUFFER = GRALLOC_USAGE_PRIVATE_0,
 
@@ -241,6 +247,7 @@ static const uint64_t VALID_USAGE =
     GRALLOC_USAGE_PRIVATE_13 |         /* 1U << 54 */
     GRALLOC_USAGE_PRIVATE_12 |         /* 1U << 55 */
     GRALLOC_USAGE_PRIVATE_11 |         /* 1U << 56 */
+    GRALLOC_USAGE_PRIVATE_6 |          /* 1U << 61 */
     GRALLOC_USAGE_PRIVATE_0 |          /* 1U << 28 */
     GRALLOC_USAGE_PRIVATE_1 |          /* 1U << 29 */
     GRALLOC_USAGE_PRIVATE_2 |          /* 1U << 30 */